@@ -0,0 +1,78 @@
+#include "utility.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+// Roster giả lập: không có quote, giống file điểm danh xuất từ các khoa
+static fs::path makeRoster(std::size_t rows) {
+    fs::path file = fs::temp_directory_path() / "diemdanh_bench_roster.csv";
+    std::ofstream ofs(file, std::ios::binary);
+
+    ofs << "mssv,ho_ten,lop,khoa,phong,buoi,thoi_gian,trang_thai\n";
+    for (std::size_t i = 0; i < rows; ++i) {
+        ofs << 2110000 + i << ",Nguyen Van " << i << ",CTK4" << i % 10 << ",CNTT,A" << i % 300
+            << "," << i % 120 << ",01/09/2025 07:00:00," << (i % 7 ? "co mat" : "vang") << "\n";
+    }
+    return file;
+}
+
+template <typename Fn>
+static void run(const std::string& name, std::size_t bytes, Fn&& fn) {
+    using clock = std::chrono::steady_clock;
+
+    double best = 1e30;
+    std::size_t rows = 0;
+    for (int i = 0; i < 3; ++i) {
+        auto start = clock::now();
+        rows = fn();
+        best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+    }
+
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << rows << " rows"
+              << std::setw(10) << std::fixed << std::setprecision(3) << best << " s"
+              << std::setw(10) << std::setprecision(3) << bytes / best / 1e9 << " GB/s\n";
+}
+
+int main(int argc, char** argv) {
+    const std::size_t rows = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const fs::path file = makeRoster(rows);
+    const std::size_t bytes = fs::file_size(file);
+
+    std::cout << "roster: " << rows << " rows, " << bytes / (1 << 20) << " MB\n";
+
+    run("read_csv", bytes, [&] {
+        return utility_csv::read_csv(file).row_count();
+    });
+    run("read_csv_parallel (1 thread)", bytes, [&] {
+        return utility_csv::read_csv_parallel(file, ',', true, 1).row_count();
+    });
+    run("read_csv_parallel (all)", bytes, [&] {
+        return utility_csv::read_csv_parallel(file).row_count();
+    });
+
+    const auto data = utility_csv::read_csv(file);
+    const fs::path out = fs::temp_directory_path() / "diemdanh_bench_out.csv";
+
+    run("DelimWriter (ofstream)", bytes, [&] {
+        std::ofstream ofs(out, std::ios::binary);
+        auto writer = csv::make_csv_writer(ofs);
+        writer << data.headers();
+        for (const auto& row : data.rows)
+            writer << row;
+        return data.row_count();
+    });
+    run("write_csv", bytes, [&] {
+        utility_csv::write_csv(out, data);
+        return data.row_count();
+    });
+    run("write_csv (all threads)", bytes, [&] {
+        utility_csv::write_csv(out, data, { .threads = 0 });
+        return data.row_count();
+    });
+
+    fs::remove(out);
+    fs::remove(file);
+}
@@ -6,16 +6,219 @@
 #include <iomanip>
 #include <chrono>
 #include <sstream>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+
+// Tham số cost cho crypto_pwhash_str khi tạo hash mới
+struct HashProfile {
+    unsigned long long opslimit = crypto_pwhash_OPSLIMIT_INTERACTIVE;
+    std::size_t memlimit = crypto_pwhash_MEMLIMIT_INTERACTIVE;
+
+    bool operator==(const HashProfile&) const = default;
+
+    // File cấu hình riêng của người dùng ($XDG_CONFIG_HOME, ~/.config hoặc %APPDATA%),
+    // do `diemdanh --calibrate-hash` ghi ra. Không có thư mục nào thì dùng thư mục hiện hành
+    static std::filesystem::path defaultPath();
+    // File cấu hình chung đặt cạnh file thực thi (vd. do người đóng gói cài sẵn): chỉ để đọc
+    // khi người dùng chưa calibrate, không bao giờ ghi vào. Rỗng nếu không xác định được
+    static std::filesystem::path installedPath();
+
+    // nullopt nếu file không có hoặc giá trị nằm ngoài giới hạn của libsodium
+    static std::optional<HashProfile> load(const std::filesystem::path& file);
+    void save(const std::filesystem::path& file) const;
+
+    // Profile dùng cho các Account mới: lần đầu nạp từ defaultPath() rồi installedPath(),
+    // không có thì dùng mức INTERACTIVE của libsodium
+    static HashProfile current();
+    static void setCurrent(const HashProfile& profile);
+};
+
+struct HashCalibration {
+    HashProfile profile;
+    std::chrono::milliseconds latency; // thời gian băm đo được với profile
+};
+
+// Đo thời gian băm trên máy hiện tại và chọn ops/mem gần target nhất,
+// bộ nhớ không vượt max_memlimit
+HashCalibration calibrateHash(
+    std::chrono::milliseconds target = std::chrono::milliseconds(250),
+    std::size_t max_memlimit = crypto_pwhash_MEMLIMIT_INTERACTIVE * 4
+);
 
 class Account {
     std::string _username;
     std::string _password_hash;
 
+    Account() = default;
+
 public:
+    // Băm theo HashProfile::current()
     Account(const std::string& username, const std::string& raw_password);
+    Account(const std::string& username, const std::string& raw_password, const HashProfile& profile);
+
+    // Dùng lại hash đã lưu (chuỗi của crypto_pwhash_str) mà không băm lại;
+    // throw std::invalid_argument nếu hash sai định dạng
+    static Account fromHash(const std::string& username, const std::string& password_hash);
 
     bool verifyPassword(const std::string& raw_password) const;
+    // Hash được tạo với tham số khác profile (thường là profile cũ hơn)
+    bool needsRehash(const HashProfile& profile = HashProfile::current()) const;
     const std::string& getUsername() const;
+    const std::string& getPasswordHash() const;
+};
+
+enum class Verification {
+    Accepted,  // đúng mật khẩu
+    Denied,    // sai mật khẩu
+    Overloaded // không được nhận: hàng đợi đầy hoặc chờ quá hạn
+};
+
+class VerificationScheduler;
+
+// Danh sách tài khoản lưu trong file CSV "username,password_hash".
+// Nạp file chỉ kiểm tra định dạng hash, không băm lại mật khẩu nào.
+// Dùng được từ nhiều luồng; login() có thể nâng cấp hash ở luồng nền.
+class AccountStore {
+    std::filesystem::path _file;
+    VerificationScheduler* _scheduler; // nullptr là xác thực thẳng trên luồng gọi
+    std::vector<Account> _accounts;
+    std::unordered_map<std::string, std::size_t> _index; // username -> vị trí trong _accounts
+
+    mutable std::mutex _mutex;
+    std::mutex _save_mutex; // giữ từ lúc chụp tới khi ghi xong; khóa trước _mutex
+
+    // Hàng đợi nâng cấp hash: mật khẩu vừa xác thực đúng cùng hash đã dùng để xác thực.
+    // Hash đó đổi trong lúc chờ (đổi mật khẩu, xóa rồi tạo lại) thì bỏ lần nâng cấp
+    struct Upgrade {
+        std::string username;
+        std::string password;
+        std::string verified_hash;
+    };
+    std::deque<Upgrade> _upgrades;
+    std::size_t _pending = 0; // còn trong hàng đợi hoặc chưa ghi xuống file
+    bool _stopping = false;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::thread _upgrader;
+
+    void upgradeLoop();
+    void write();
+
+public:
+    // Nạp file nếu đã có, chưa có thì bắt đầu rỗng. Có scheduler thì mọi lần
+    // login() xác thực qua nó (scheduler phải sống lâu hơn store)
+    explicit AccountStore(std::filesystem::path file, VerificationScheduler* scheduler = nullptr);
+    // Chờ các lần nâng cấp còn dở được ghi xong
+    ~AccountStore();
+
+    AccountStore(const AccountStore&) = delete;
+    AccountStore& operator=(const AccountStore&) = delete;
+
+    // throw std::invalid_argument nếu username đã tồn tại
+    void add(Account account);
+    bool remove(const std::string& username);
+    std::optional<Account> find(const std::string& username) const;
+
+    // Xác thực mật khẩu; không có tài khoản thì Denied, scheduler từ chối thì Overloaded.
+    // Nếu đúng mà hash còn dùng tham số cũ thì băm lại theo HashProfile::current()
+    // và ghi file ở luồng nền, không làm chậm lần đăng nhập
+    Verification login(const std::string& username, const std::string& raw_password);
+    // Chờ tới khi mọi hash đang chờ nâng cấp đã được ghi xuống file
+    void waitForUpgrades();
+
+    std::vector<Account> accounts() const;
+    std::size_t size() const;
+
+    // Ghi toàn bộ ra file (atomic, như write_csv), quyền 0600; store rỗng ghi file chỉ có header
+    void save();
+};
+
+struct ProvisionRequest {
+    std::string username;
+    std::string raw_password;
+};
+
+struct ProvisionProgress {
+    std::size_t done = 0;    // đã có hash, kể cả phần lấy lại từ checkpoint
+    std::size_t total = 0;
+    std::size_t resumed = 0; // lấy lại từ checkpoint, không phải băm
+};
+
+struct ProvisionOptions {
+    // File "username,password_hash" ghi nối từng tài khoản ngay khi băm xong;
+    // chạy lại với cùng file sẽ bỏ qua các tài khoản đã có trong đó. Rỗng là không dùng
+    std::filesystem::path checkpoint;
+    std::size_t max_workers = 0; // 0 là theo hashingConcurrency()
+    // Gọi tuần tự (không đồng thời) sau mỗi tài khoản
+    std::function<void(const ProvisionProgress&)> on_progress;
+};
+
+// Số lần băm chạy đồng thời được: mỗi lần giữ HashProfile::current().memlimit
+// byte, nên bị chặn bởi bộ nhớ còn trống lẫn số core
+std::size_t hashingConcurrency();
+
+// Tạo hàng loạt tài khoản, băm mật khẩu trên một nhóm worker.
+// Kết quả theo đúng thứ tự của requests
+std::vector<Account> provisionAccounts(const std::vector<ProvisionRequest>& requests, const ProvisionOptions& options = {});
+
+struct VerificationMetrics {
+    std::size_t queue_depth = 0;     // đang chờ
+    std::size_t max_queue_depth = 0;
+    std::size_t in_flight = 0;       // đang băm
+    std::size_t max_in_flight = 0;
+    std::size_t memory_in_use = 0;   // byte đang giữ trong semaphore
+    std::size_t admitted = 0;
+    std::size_t rejected_full = 0;     // hàng đợi đã đầy khi tới
+    std::size_t rejected_deadline = 0; // chờ quá deadline
+    std::chrono::microseconds total_wait{ 0 }; // tổng thời gian chờ của các lần được nhận
+    std::chrono::microseconds max_wait{ 0 };
+
+    std::chrono::microseconds averageWait() const;
+};
+
+struct SchedulerOptions {
+    std::size_t memory_budget = 0; // byte cho các lần băm đồng thời, 0 là 3/4 bộ nhớ còn trống
+    std::size_t max_queue = 256;
+    std::chrono::milliseconds deadline{ 2000 }; // chờ lâu hơn thì trả về Overloaded
+};
+
+// Điều phối verifyPassword khi nhiều người đăng nhập cùng lúc: mỗi lần xác thực
+// giữ đúng lượng bộ nhớ argon2 ghi trong hash (tham số m=) từ một semaphore theo
+// byte, ai tới trước được vào trước (FIFO), hàng đợi có giới hạn và mỗi yêu cầu
+// bị từ chối nếu không được vào trước deadline.
+class VerificationScheduler {
+    struct Waiter {
+        std::size_t cost;
+    };
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<const Waiter*> _queue;
+
+    std::size_t _budget;
+    std::size_t _max_queue;
+    std::chrono::milliseconds _deadline;
+    VerificationMetrics _metrics;
+
+    bool admit(std::size_t cost);
+    void release(std::size_t cost);
+
+public:
+    explicit VerificationScheduler(const SchedulerOptions& options = {});
+
+    // Chặn luồng gọi tới khi được nhận hoặc bị từ chối
+    Verification verify(const Account& account, const std::string& raw_password);
+
+    VerificationMetrics metrics() const;
+    std::size_t memoryBudget() const;
 };
 
 class DateTime {
@@ -26,6 +229,8 @@ public:
     DateTime(int day, int month, int year, int hour = 0, int minute = 0, int second = 0);
 
     static DateTime now();
+    // Nhận "dd/mm/yyyy", "dd/mm/yyyy hh:mm" hoặc "dd/mm/yyyy hh:mm:ss" (định dạng của toString)
+    static std::optional<DateTime> parse(std::string_view text);
 
     int day() const;
     int month() const;
@@ -45,4 +250,7 @@ public:
     bool operator<(const DateTime& other) const;
     bool operator>(const DateTime& other) const;
 
-};
\ No newline at end of file
+};
+
+// Cho utility_csv::read_csv_as đọc cột ngày giờ
+bool from_csv(std::string_view text, DateTime& out);
\ No newline at end of file
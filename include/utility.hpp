@@ -8,8 +8,63 @@
 #include <stdexcept>
 #include <concepts>
 #include <optional>
+#include <string_view>
 #include <limits>
 #include <charconv>
+#include <type_traits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <deque>
+
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define UTILITY_CSV_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define UTILITY_CSV_TARGET_AVX2
+#else
+#define UTILITY_CSV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define UTILITY_CSV_X86 0
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 
 enum class Command {
     Add, Update, Delete, List, Exit
@@ -25,10 +80,85 @@ namespace utility_csv {
     using Row = std::vector<Cell>;
     using Rows = std::vector<Row>;
 
+    namespace detail {
+        struct StringHash {
+            using is_transparent = void;
+
+            std::size_t operator()(std::string_view str) const {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+    }
+
+    // Tên cột -> vị trí, dựng một lần từ header; header trùng tên sẽ throw.
+    // Đây là chỗ duy nhất kiểm tra header trùng tên, source (tên file) chỉ để ghi vào lỗi
+    class ColumnIndex {
+        std::unordered_map<std::string, std::size_t, detail::StringHash, std::equal_to<>> _columns;
+
+    public:
+        ColumnIndex() = default;
+
+        explicit ColumnIndex(const Row& headers, std::string_view source = {}) {
+            _columns.reserve(headers.size());
+            for (std::size_t i = 0; i < headers.size(); ++i) {
+                if (_columns.emplace(headers[i], i).second)
+                    continue;
+                std::string message = "Duplicate CSV column: " + headers[i];
+                if (!source.empty())
+                    message += " in " + std::string(source);
+                throw std::runtime_error(message);
+            }
+        }
+
+        std::optional<std::size_t> find(std::string_view name) const {
+            if (auto it = _columns.find(name); it != _columns.end())
+                return it->second;
+            return std::nullopt;
+        }
+
+        std::size_t at(std::string_view name) const {
+            if (auto it = _columns.find(name); it != _columns.end())
+                return it->second;
+            throw std::runtime_error("CSV column not found: " + std::string(name));
+        }
+
+        bool empty() const {
+            return _columns.empty();
+        }
+
+        std::size_t size() const {
+            return _columns.size();
+        }
+    };
+
+    template <typename T>
+    struct ColumnHandle;
+
+    // headers chỉ đổi được qua set_headers() nên bảng tên cột luôn khớp,
+    // tra cột không phải so lại header hay dựng bảng mới
     struct CSVData {
-        Row headers;
         Rows rows;
 
+        CSVData() = default;
+
+        CSVData(Row headers, Rows rows = {}) : rows(std::move(rows)) {
+            set_headers(std::move(headers));
+        }
+
+        const Row& headers() const {
+            return _headers;
+        }
+
+        // Header trùng tên sẽ throw; source (tên file) chỉ để ghi vào lỗi
+        void set_headers(Row headers, std::string_view source = {}) {
+            _index = ColumnIndex(headers, source);
+            _headers = std::move(headers);
+        }
+
+        const ColumnIndex& columns() const {
+            return _index;
+        }
+
         bool empty() const {
             return rows.empty();
         }
@@ -37,89 +167,3969 @@ namespace utility_csv {
             return rows.size();
         }
 
+        std::size_t column_count() const {
+            return _headers.size();
+        }
+
+        std::optional<std::size_t> find_column(std::string_view name) const {
+            return _index.find(name);
+        }
+
+        std::size_t column_of(std::string_view name) const {
+            return _index.at(name);
+        }
+
+        // Tìm cột một lần, sau đó mỗi lần lấy cell chỉ là truy cập theo vị trí:
+        //   auto diem = data.handle<int>("diem");
+        //   for (const auto& row : data.rows) total += diem(row);
+        template <typename T = std::string_view>
+        ColumnHandle<T> handle(std::string_view name) const {
+            return ColumnHandle<T>{ column_of(name), std::string(name) };
+        }
+
+    private:
+        Row _headers;
+        ColumnIndex _index;
+    };
+    
+    // Lưu theo cột: mỗi cột là một mảng offset liền nhau trỏ vào một arena chung,
+    // cell của cùng một cột nằm sát nhau trong arena.
+    struct ColumnarCSVData {
+        Row headers;
+        std::string arena;
+        std::vector<std::vector<std::size_t>> offsets; // offsets[c] có row_count() + 1 phần tử
+
+        bool empty() const {
+            return row_count() == 0;
+        }
+
+        std::size_t row_count() const {
+            return offsets.empty() ? 0 : offsets.front().size() - 1;
+        }
+
         std::size_t column_count() const {
             return headers.size();
         }
+
+        std::string_view cell(std::size_t row, std::size_t column) const {
+            const auto& col = offsets[column];
+            return std::string_view(arena).substr(col[row], col[row + 1] - col[row]);
+        }
+
+        Row row(std::size_t index) const {
+            Row r;
+            r.reserve(column_count());
+            for (std::size_t c = 0; c < column_count(); ++c)
+                r.emplace_back(cell(index, c));
+            return r;
+        }
+    };
+
+    // Xem một record mà không copy: cell trỏ thẳng vào buffer của csv::CSVRow,
+    // chỉ hợp lệ trong lúc callback đang chạy.
+    class RowView {
+        const csv::CSVRow& _row;
+        const Row& _headers;
+        std::size_t _line;
+
+    public:
+        RowView(const csv::CSVRow& row, const Row& headers, std::size_t line)
+            : _row(row), _headers(headers), _line(line) {}
+
+        std::size_t size() const {
+            return _row.size();
+        }
+
+        std::string_view operator[](std::size_t index) const {
+            return _row[index].get_sv();
+        }
+
+        const Row& headers() const {
+            return _headers;
+        }
+
+        std::size_t line() const {
+            return _line;
+        }
+
+        Row to_row() const {
+            Row r;
+            r.reserve(size());
+            for (std::size_t i = 0; i < size(); ++i)
+                r.emplace_back((*this)[i]);
+            return r;
+        }
     };
+
+    namespace detail {
+        inline void check_file(const std::filesystem::path& file) {
+            if (!std::filesystem::exists(file))
+                throw std::runtime_error("CSV file not found: " + file.string());
+            
+            if (!std::filesystem::is_regular_file(file))
+                throw std::runtime_error("Not a regular file: " + file.string());
+            
+            if (std::filesystem::file_size(file) == 0)
+                throw std::runtime_error("CSV file is empty: " + file.string());
+        }
+
+        inline csv::CSVFormat make_format(char delimiter, bool trim) {
+            csv::CSVFormat format;
+            format.delimiter(delimiter);
+            format.variable_columns(true); // true sẽ cho throw
+                                           // false sẽ in ra cho dù có thiếu cell
+                                           // không có sẽ bỏ qua row đó luôn
+            
+            if (trim)
+                format.trim({ ' ', '\t' });
+
+            return format;
+        }
+
+        inline std::runtime_error integrity_error(std::size_t line, std::size_t expected, std::size_t got) {
+            return std::runtime_error("CSV integrity error at line " + std::to_string(line)
+                                      + ": expected " + std::to_string(expected) 
+                                      + " columns, got " + std::to_string(got)
+            );
+        }
+
+        // Chưa kiểm tra header trùng tên: người gọi phải dựng ColumnIndex(headers, file)
+        // (hoặc CSVData::set_headers) trước khi dùng
+        inline Row header_row(const csv::CSVReader& reader, const std::filesystem::path& file) {
+            Row headers = reader.get_col_names();
+            if (headers.empty())
+                throw std::runtime_error("CSV has no header: " + file.string());
+            return headers;
+        }
+
+        // Cho loader không tra cột theo tên; header trùng tên vẫn bị chặn qua ColumnIndex
+        inline Row read_headers(const csv::CSVReader& reader, const std::filesystem::path& file) {
+            Row headers = header_row(reader, file);
+            (void)ColumnIndex(headers, file.string());
+            return headers;
+        }
+
+        // Duyệt từng record, kiểm tra số cột; fn trả về false để dừng sớm
+        template <typename Fn>
+        std::size_t visit_rows(csv::CSVReader& reader, const Row& headers, Fn&& fn) {
+            const std::size_t column_count = headers.size();
+            std::size_t row_index = 1;
+            std::size_t visited = 0;
+
+            for (auto& row : reader) {
+                ++row_index;
+
+                if (row.size() != column_count)
+                    throw integrity_error(row_index, column_count, row.size());
+
+                ++visited;
+                const RowView view(row, headers, row_index);
+
+                if constexpr (std::is_same_v<std::invoke_result_t<Fn&, const RowView&>, bool>) {
+                    if (!fn(view))
+                        break;
+                }
+                else {
+                    fn(view);
+                }
+            }
+
+            return visited;
+        }
+    }
     
-    CSVData read_csv(
+    // Chỉ lấy những cột cần dùng, theo tên và/hoặc theo chỉ số:
+    //   read_csv(file, Projection{ .names = { "mssv", "trang_thai" } })
+    struct Projection {
+        std::vector<std::string> names = {};
+        std::vector<std::size_t> indices = {};
+
+        std::vector<std::size_t> resolve(const ColumnIndex& index, std::size_t column_count) const {
+            std::vector<std::size_t> columns;
+            columns.reserve(names.size() + indices.size());
+
+            for (const auto& name : names)
+                columns.push_back(index.at(name));
+
+            for (auto index : indices) {
+                if (index >= column_count)
+                    throw std::runtime_error("CSV column index out of range: " + std::to_string(index));
+                columns.push_back(index);
+            }
+
+            return columns;
+        }
+    };
+
+    inline CSVData read_csv(
         const std::filesystem::path& file,
         char delimiter = ',',
         bool trim = true
     ) {
-        if (!std::filesystem::exists(file))
-            throw std::runtime_error("CSV file not found: " + file.string());
-        
-        if (!std::filesystem::is_regular_file(file))
-            throw std::runtime_error("Not a regular file: " + file.string());
+        detail::check_file(file);
         
-        if (std::filesystem::file_size(file) == 0)
-            throw std::runtime_error("CSV file is empty: " + file.string());
-        
-        csv::CSVFormat format;
-        format.delimiter(delimiter);
-        format.variable_columns(true); // true sẽ cho throw
-                                       // false sẽ in ra cho dù có thiếu cell
-                                       // không có sẽ bỏ qua row đó luôn
-        
-        if (trim)
-            format.trim({ ' ', '\t' });
-        
-        csv::CSVReader reader(file.string(), format);
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
         
         CSVData data;
-        
-        data.headers = reader.get_col_names();
-        if (data.headers.empty())
-            throw std::runtime_error("CSV has no header: " + file.string());
-        
-        const std::size_t column_count = data.headers.size();
-        std::size_t row_index = 1;
+        data.set_headers(detail::header_row(reader, file), file.string());
 
-        for (auto& row : reader) {
-            ++row_index;
+        detail::visit_rows(reader, data.headers(), [&](const RowView& row) {
+            data.rows.push_back(row.to_row());
+        });
 
-            if (row.size() != column_count)
-                throw std::runtime_error("CSV integrity error at line " + std::to_string(row_index)
-                                        + ": expected " + std::to_string(column_count) 
-                                        + " columns, got " + std::to_string(row.size())
-                );
+        return data;
+    }
+
+    // Như read_csv nhưng chỉ copy các cột trong projection; các cột khác
+    // vẫn được kiểm tra số lượng nhưng không bao giờ được copy ra
+    inline CSVData read_csv(
+        const std::filesystem::path& file,
+        const Projection& projection,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+        const Row headers = detail::header_row(reader, file);
+        const auto columns = projection.resolve(ColumnIndex(headers, file.string()), headers.size());
+
+        Row picked;
+        picked.reserve(columns.size());
+        for (auto c : columns)
+            picked.push_back(headers[c]);
 
+        CSVData data;
+        data.set_headers(std::move(picked));
+
+        detail::visit_rows(reader, headers, [&](const RowView& row) {
             Row r;
-            r.reserve(column_count);
-            
-            for (auto& cell : row) 
-                r.push_back(cell.get<std::string>());
-            
+            r.reserve(columns.size());
+            for (auto c : columns)
+                r.emplace_back(row[c]);
             data.rows.push_back(std::move(r));
-        }
+        });
 
         return data;
     }
 
-    void write_csv(
-        const std::filesystem::path& filename,
-        const CSVData& data
+    namespace detail {
+        inline ColumnarCSVData read_columnar(
+            csv::CSVReader& reader,
+            const Row& headers,
+            const std::vector<std::size_t>& picked
+        ) {
+            ColumnarCSVData data;
+            for (auto c : picked)
+                data.headers.push_back(headers[c]);
+
+            const std::size_t column_count = picked.size();
+
+            // Gom từng cột vào buffer riêng rồi nối lại, để cell cùng cột nằm liền nhau
+            std::vector<std::string> columns(column_count);
+            data.offsets.assign(column_count, { 0 });
+
+            visit_rows(reader, headers, [&](const RowView& row) {
+                for (std::size_t c = 0; c < column_count; ++c) {
+                    columns[c] += row[picked[c]];
+                    data.offsets[c].push_back(columns[c].size());
+                }
+            });
+
+            std::size_t total = 0;
+            for (const auto& col : columns)
+                total += col.size();
+            data.arena.reserve(total);
+
+            for (std::size_t c = 0; c < column_count; ++c) {
+                const std::size_t base = data.arena.size();
+                data.arena += columns[c];
+                std::string().swap(columns[c]);
+
+                for (auto& offset : data.offsets[c])
+                    offset += base;
+            }
+
+            return data;
+        }
+    }
+
+    inline ColumnarCSVData read_csv_columnar(
+        const std::filesystem::path& file,
+        char delimiter = ',',
+        bool trim = true
     ) {
-        if (data.empty()) 
-            throw std::runtime_error("CSV headers are empty");
-        
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+        const Row headers = detail::read_headers(reader, file);
+
+        std::vector<std::size_t> all(headers.size());
+        for (std::size_t c = 0; c < all.size(); ++c)
+            all[c] = c;
+
+        return detail::read_columnar(reader, headers, all);
+    }
+
+    inline ColumnarCSVData read_csv_columnar(
+        const std::filesystem::path& file,
+        const Projection& projection,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+        const Row headers = detail::header_row(reader, file);
+        const auto columns = projection.resolve(ColumnIndex(headers, file.string()), headers.size());
+
+        return detail::read_columnar(reader, headers, columns);
+    }
+
+    // Đọc kiểu streaming: không giữ lại row nào, bộ nhớ không phụ thuộc kích thước file.
+    // fn nhận const RowView&, trả về void hoặc bool (false để dừng).
+    template <typename Fn>
+    std::size_t for_each_row(
+        const std::filesystem::path& file,
+        Fn&& fn,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+        const Row headers = detail::read_headers(reader, file);
+
+        return detail::visit_rows(reader, headers, fn);
+    }
+
+    // Bảng giá trị phân biệt của một cột: code là thứ tự xuất hiện đầu tiên
+    template <std::unsigned_integral Code = std::uint32_t>
+    class Dictionary {
+        std::vector<std::string> _values;
+        std::unordered_map<std::string, Code, detail::StringHash, std::equal_to<>> _codes;
+
+    public:
+        Code encode(std::string_view value) {
+            if (auto it = _codes.find(value); it != _codes.end())
+                return it->second;
+
+            if (_values.size() > std::numeric_limits<Code>::max())
+                throw std::runtime_error("Dictionary overflow: more than "
+                                         + std::to_string(std::size_t{ std::numeric_limits<Code>::max() } + 1)
+                                         + " distinct values");
+
+            const auto code = static_cast<Code>(_values.size());
+            _values.emplace_back(value);
+            _codes.emplace(_values.back(), code);
+            return code;
+        }
+
+        std::optional<Code> find(std::string_view value) const {
+            if (auto it = _codes.find(value); it != _codes.end())
+                return it->second;
+            return std::nullopt;
+        }
+
+        const std::string& value(Code code) const {
+            return _values.at(code);
+        }
+
+        std::size_t size() const {
+            return _values.size();
+        }
+    };
+
+    template <std::unsigned_integral Code = std::uint32_t>
+    struct EncodedColumn {
+        std::size_t column; // vị trí trong headers
+        Dictionary<Code> dictionary;
+        std::vector<Code> codes; // một code cho mỗi row
+    };
+
+    // Các cột lặp lại nhiều (mã lớp, trạng thái, khoa, phòng...) lưu thành code
+    // số nguyên cộng một dictionary chung cho cả cột; các cột còn lại giữ như CSVData.
+    // So sánh và group-by trên cột đã mã hóa chỉ còn là so sánh số.
+    template <std::unsigned_integral Code = std::uint32_t>
+    struct EncodedCSVData {
+        Row headers;
+        ColumnIndex columns; // dựng từ headers lúc đọc
+        Rows rows; // chỉ gồm các cột không mã hóa, giữ thứ tự trong headers
+        std::vector<EncodedColumn<Code>> encoded;
+
+        // slots[c] >= 0 là vị trí trong rows, < 0 là -(i + 1) với i là vị trí trong encoded
+        std::vector<std::ptrdiff_t> slots;
+
+        bool empty() const {
+            return row_count() == 0;
+        }
+
+        std::size_t row_count() const {
+            return encoded.empty() ? rows.size() : encoded.front().codes.size();
+        }
+
+        std::size_t column_count() const {
+            return headers.size();
+        }
+
+        // nullptr nếu cột không được mã hóa
+        const EncodedColumn<Code>* encoded_column(std::string_view name) const {
+            const auto slot = slots[columns.at(name)];
+            return slot < 0 ? &encoded[-(slot + 1)] : nullptr;
+        }
+
+        std::string_view cell(std::size_t row, std::size_t column) const {
+            const auto slot = slots[column];
+            if (slot >= 0)
+                return rows[row][slot];
+
+            const auto& col = encoded[-(slot + 1)];
+            return col.dictionary.value(col.codes[row]);
+        }
+
+        CSVData to_csv_data() const {
+            CSVData data(headers);
+            data.rows.reserve(row_count());
+            for (std::size_t r = 0; r < row_count(); ++r) {
+                Row row;
+                row.reserve(column_count());
+                for (std::size_t c = 0; c < column_count(); ++c)
+                    row.emplace_back(cell(r, c));
+                data.rows.push_back(std::move(row));
+            }
+            return data;
+        }
+    };
+
+    // Đọc như read_csv nhưng mã hóa các cột được chọn trong projection:
+    //   read_csv_encoded<std::uint16_t>(file, Projection{ .names = { "lop", "trang_thai" } })
+    template <std::unsigned_integral Code = std::uint32_t>
+    EncodedCSVData<Code> read_csv_encoded(
+        const std::filesystem::path& file,
+        const Projection& encode,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+
+        EncodedCSVData<Code> data;
+        data.headers = detail::header_row(reader, file);
+        data.columns = ColumnIndex(data.headers, file.string());
+
         const std::size_t column_count = data.headers.size();
-        if (column_count == 0) 
-            throw std::runtime_error("CSV has no headers");
+        data.slots.assign(column_count, 0);
+        for (auto c : encode.resolve(data.columns, column_count)) {
+            if (data.slots[c] < 0)
+                continue;
+            data.encoded.push_back({ c, {}, {} });
+            data.slots[c] = -static_cast<std::ptrdiff_t>(data.encoded.size());
+        }
 
-        for (const auto& r : data.rows)
-            if (r.size() > column_count)
-                throw std::runtime_error("Row has more columns than header");
-        
-        std::ofstream ofs(filename.string(), std::ios::binary);
-        if (!ofs) 
-            throw std::runtime_error("Failed to open file: " + filename.string());
+        std::vector<std::size_t> plain;
+        for (std::size_t c = 0; c < column_count; ++c) {
+            if (data.slots[c] < 0)
+                continue;
+            data.slots[c] = static_cast<std::ptrdiff_t>(plain.size());
+            plain.push_back(c);
+        }
+
+        detail::visit_rows(reader, data.headers, [&](const RowView& row) {
+            for (auto& col : data.encoded)
+                col.codes.push_back(col.dictionary.encode(row[col.column]));
+
+            if (plain.empty())
+                return;
+
+            Row r;
+            r.reserve(plain.size());
+            for (auto c : plain)
+                r.emplace_back(row[c]);
+            data.rows.push_back(std::move(r));
+        });
+
+        return data;
+    }
+
+    // Ánh xạ một cột CSV (theo tên) vào một thành viên của struct T
+    template <typename T, typename M>
+    struct Column {
+        std::string_view name;
+        M T::* member;
+    };
+
+    template <typename T, typename M>
+    constexpr Column<T, M> column(std::string_view name, M T::* member) {
+        return { name, member };
+    }
+
+    // Chuyên biệt hóa để khai báo schema mặc định cho một kiểu:
+    //   template <> struct CSVSchema<Student> {
+    //       static constexpr auto columns = std::make_tuple(column("mssv", &Student::id), ...);
+    //   };
+    template <typename T>
+    struct CSVSchema;
+
+    // Chuỗi, số (qua std::from_chars) hoặc kiểu tự định nghĩa có hàm
+    // bool from_csv(std::string_view, T&) tìm được qua ADL
+    template <typename T>
+    bool parse_cell(std::string_view text, T& out) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            out.assign(text);
+            return true;
+        }
+        else if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+            T value{};
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != std::errc{} || ptr != text.data() + text.size())
+                return false;
+            out = value;
+            return true;
+        }
+        else {
+            return from_csv(text, out);
+        }
+    }
+
+    // Cột đã biết vị trí, dùng được với Row hoặc RowView
+    template <typename T>
+    struct ColumnHandle {
+        std::size_t index;
+        std::string name;
+
+        template <typename R>
+        T operator()(const R& row) const {
+            const std::string_view text = row[index];
+            if constexpr (std::is_same_v<T, std::string_view>) {
+                return text;
+            }
+            else {
+                T value{};
+                if (!parse_cell(text, value))
+                    throw std::runtime_error("CSV parse error in column " + name + ": '" + std::string(text) + "'");
+                return value;
+            }
+        }
+    };
+
+    namespace detail {
+        template <typename T, typename M>
+        void assign_cell(const RowView& row, std::size_t index, const Column<T, M>& col, T& record) {
+            if (!parse_cell(row[index], record.*(col.member)))
+                throw std::runtime_error("CSV parse error at line " + std::to_string(row.line())
+                                         + ", column " + std::string(col.name)
+                                         + ": '" + std::string(row[index]) + "'"
+                );
+        }
+    }
+
+    // Đọc thẳng vào struct: vị trí cột được tìm một lần theo tên,
+    // mỗi cell được parse đúng một lần, không tạo Row trung gian
+    template <typename T, typename... M>
+    std::vector<T> read_csv_as(
+        const std::filesystem::path& file,
+        const std::tuple<Column<T, M>...>& schema,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+        const Row headers = detail::header_row(reader, file);
+        const ColumnIndex columns(headers, file.string());
+
+        std::array<std::size_t, sizeof...(M)> index{};
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((index[I] = columns.at(std::get<I>(schema).name)), ...);
+        }(std::index_sequence_for<M...>{});
+
+        std::vector<T> records;
+        detail::visit_rows(reader, headers, [&](const RowView& row) {
+            T record{};
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (detail::assign_cell(row, index[I], std::get<I>(schema), record), ...);
+            }(std::index_sequence_for<M...>{});
+            records.push_back(std::move(record));
+        });
+
+        return records;
+    }
+
+    template <typename T>
+    std::vector<T> read_csv_as(
+        const std::filesystem::path& file,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        return read_csv_as(file, CSVSchema<T>::columns, delimiter, trim);
+    }
+
+    namespace detail {
+        constexpr std::size_t PARALLEL_MIN_CHUNK = 1 << 20;
+
+        inline bool is_newline(char ch) {
+            return ch == '\r' || ch == '\n';
+        }
+
+        // Trả về vị trí bắt đầu record kế tiếp (sau cả chuỗi ký tự xuống dòng),
+        // theo đúng luật quote của csv::CSVReader. pos phải nằm ngoài quote.
+        inline std::size_t next_record(
+            std::string_view text,
+            std::size_t pos,
+            char delimiter,
+            bool trim,
+            bool field_empty = true
+        ) {
+            const std::size_t n = text.size();
+            bool quoted = false;
+
+            while (pos < n) {
+                const char ch = text[pos];
+
+                if (quoted) {
+                    if (ch == '"') {
+                        if (pos + 1 == n)
+                            return n;
+
+                        const char next = text[pos + 1];
+                        if (next == delimiter || is_newline(next))
+                            quoted = false;
+                        else if (next == '"')
+                            ++pos;
+                    }
+                    ++pos;
+                    continue;
+                }
+
+                if (is_newline(ch)) {
+                    while (pos < n && is_newline(text[pos]))
+                        ++pos;
+                    return pos;
+                }
+
+                if (ch == delimiter)
+                    field_empty = true;
+                else if (ch == '"' && field_empty)
+                    quoted = true;
+                else if (!(trim && (ch == ' ' || ch == '\t')))
+                    field_empty = false;
+
+                ++pos;
+            }
+
+            return n;
+        }
+
+        // Dời target về đầu record đầu tiên nằm sau nó; from phải là đầu một record
+        inline std::size_t align_record(
+            std::string_view text,
+            std::size_t from,
+            std::size_t target,
+            char delimiter,
+            bool trim
+        ) {
+            if (target >= text.size())
+                return text.size();
+
+            // Không có quote giữa from và target thì target chắc chắn nằm ngoài quote,
+            // chỉ cần biết field hiện tại đã có nội dung hay chưa
+            if (text.substr(from, target - from).find('"') == std::string_view::npos) {
+                bool field_empty = true;
+                for (std::size_t p = target; p > from; --p) {
+                    const char ch = text[p - 1];
+                    if (ch == delimiter || is_newline(ch))
+                        break;
+                    if (!(trim && (ch == ' ' || ch == '\t'))) {
+                        field_empty = false;
+                        break;
+                    }
+                }
+                return next_record(text, target, delimiter, trim, field_empty);
+            }
+
+            std::size_t pos = from;
+            while (pos < target)
+                pos = next_record(text, pos, delimiter, trim);
+            return pos;
+        }
+
+        struct ChunkResult {
+            Rows rows;
+            std::size_t bad_row = 0; // thứ tự (từ 1) của row sai số cột đầu tiên trong chunk
+            std::size_t bad_size = 0;
+            std::exception_ptr error;
+        };
+
+        // Parser gốc của csv::CSVReader, dùng cho đoạn có quote
+        inline bool parse_quoted(std::string_view block, const Row& headers, char delimiter, bool trim, ChunkResult& result) {
+            std::stringstream ss{ std::string(block) };
+            auto format = make_format(delimiter, trim);
+            format.column_names(headers);
+
+            csv::CSVReader reader(ss, format);
+
+            for (auto& row : reader) {
+                if (row.size() != headers.size()) {
+                    result.bad_row = result.rows.size() + 1;
+                    result.bad_size = row.size();
+                    return false;
+                }
+
+                result.rows.push_back(RowView(row, headers, 0).to_row());
+            }
+
+            return true;
+        }
+
+        // Bitmask vị trí delimiter / '\r' / '\n' trong 64 byte bắt đầu từ p
+        inline std::uint64_t special_mask_scalar(const char* p, char delimiter) {
+            std::uint64_t mask = 0;
+            for (int i = 0; i < 64; ++i)
+                if (p[i] == delimiter || is_newline(p[i]))
+                    mask |= std::uint64_t{ 1 } << i;
+            return mask;
+        }
+
+#if UTILITY_CSV_X86
+        inline std::uint64_t special_mask_sse2(const char* p, char delimiter) {
+            const __m128i d = _mm_set1_epi8(delimiter);
+            const __m128i lf = _mm_set1_epi8('\n');
+            const __m128i cr = _mm_set1_epi8('\r');
+
+            std::uint64_t mask = 0;
+            for (int i = 0; i < 4; ++i) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+                const __m128i hit = _mm_or_si128(
+                    _mm_cmpeq_epi8(v, d),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))
+                );
+                mask |= std::uint64_t{ static_cast<std::uint32_t>(_mm_movemask_epi8(hit)) } << (16 * i);
+            }
+            return mask;
+        }
+
+        UTILITY_CSV_TARGET_AVX2
+        inline std::uint64_t special_mask_avx2(const char* p, char delimiter) {
+            const __m256i d = _mm256_set1_epi8(delimiter);
+            const __m256i lf = _mm256_set1_epi8('\n');
+            const __m256i cr = _mm256_set1_epi8('\r');
+
+            std::uint64_t mask = 0;
+            for (int i = 0; i < 2; ++i) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * i));
+                const __m256i hit = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(v, d),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr))
+                );
+                mask |= std::uint64_t{ static_cast<std::uint32_t>(_mm256_movemask_epi8(hit)) } << (32 * i);
+            }
+            return mask;
+        }
+
+        inline bool has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+                return false;
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        using SpecialMask = std::uint64_t (*)(const char*, char);
+
+        // Chọn bản SIMD một lần theo CPU đang chạy
+        inline SpecialMask special_mask() {
+#if UTILITY_CSV_X86
+            static const SpecialMask best = has_avx2() ? special_mask_avx2 : special_mask_sse2;
+            return best;
+#else
+            return special_mask_scalar;
+#endif
+        }
+
+        // Tách đoạn không có quote: quét 64 byte một lần bằng SIMD để tìm delimiter
+        // và xuống dòng, cho kết quả giống hệt csv::CSVReader (gộp các dòng trống,
+        // trim ' ' và '\t', quy tắc field cuối khi file không kết thúc bằng xuống dòng)
+        inline bool split_unquoted(
+            std::string_view block,
+            const Row& headers,
+            char delimiter,
+            bool trim,
+            bool at_eof,
+            ChunkResult& result,
+            SpecialMask mask_of = special_mask()
+        ) {
+            const std::size_t n = block.size();
+            const std::size_t column_count = headers.size();
+
+            Row row;
+            row.reserve(column_count);
+            std::size_t field_start = 0;
+            std::size_t skip_until = 0;
+
+            auto push_field = [&](std::size_t begin, std::size_t end) {
+                if (trim) {
+                    while (begin < end && (block[begin] == ' ' || block[begin] == '\t'))
+                        ++begin;
+                    while (end > begin && (block[end - 1] == ' ' || block[end - 1] == '\t'))
+                        --end;
+                }
+                row.emplace_back(block.substr(begin, end - begin));
+            };
+
+            auto push_row = [&] {
+                if (row.size() != column_count) {
+                    result.bad_row = result.rows.size() + 1;
+                    result.bad_size = row.size();
+                    return false;
+                }
+                result.rows.push_back(std::move(row));
+                row = Row();
+                row.reserve(column_count);
+                return true;
+            };
+
+            auto on_special = [&](std::size_t i) {
+                if (i < skip_until)
+                    return true;
+
+                push_field(field_start, i);
+
+                if (block[i] == delimiter) {
+                    field_start = i + 1;
+                    return true;
+                }
+
+                std::size_t next = i + 1;
+                while (next < n && is_newline(block[next]))
+                    ++next;
+                field_start = skip_until = next;
+
+                return push_row();
+            };
+
+            std::size_t pos = 0;
+            for (; pos + 64 <= n; pos += 64) {
+                for (std::uint64_t mask = mask_of(block.data() + pos, delimiter); mask; mask &= mask - 1)
+                    if (!on_special(pos + std::countr_zero(mask)))
+                        return false;
+            }
+
+            for (; pos < n; ++pos)
+                if ((block[pos] == delimiter || is_newline(block[pos])) && !on_special(pos))
+                    return false;
+
+            if (field_start < n || !row.empty()) {
+                push_field(field_start, n);
+
+                // Giống end_feed(): field cuối rỗng chỉ được giữ khi file kết thúc bằng delimiter
+                const auto& last = row.back();
+                if (at_eof && last.empty() && block.back() != delimiter)
+                    row.pop_back();
+
+                if (!row.empty())
+                    return push_row();
+            }
+
+            return true;
+        }
+
+        constexpr std::size_t FAST_BLOCK = 1 << 16;
+
+        // Chunk không có quote đi thẳng đường SIMD; nếu có, chia nhỏ thành các khối
+        // ~64KB và chỉ khối nào chứa quote mới dùng lại parser gốc
+        inline ChunkResult parse_chunk(
+            std::string_view text,
+            std::size_t begin,
+            std::size_t end,
+            const Row& headers,
+            char delimiter,
+            bool trim
+        ) {
+            ChunkResult result;
+            const bool at_eof = end == text.size();
+            const auto chunk = text.substr(begin, end - begin);
+
+            if (chunk.find('"') == std::string_view::npos) {
+                split_unquoted(chunk, headers, delimiter, trim, at_eof, result);
+                return result;
+            }
+
+            for (std::size_t pos = begin; pos < end;) {
+                const std::size_t target = pos + FAST_BLOCK;
+                const std::size_t next = target >= end ? end : align_record(text, pos, target, delimiter, trim);
+                const auto block = text.substr(pos, next - pos);
+
+                const std::size_t done = result.rows.size();
+                ChunkResult part;
+                const bool ok = block.find('"') == std::string_view::npos
+                    ? split_unquoted(block, headers, delimiter, trim, at_eof && next == end, part)
+                    : parse_quoted(block, headers, delimiter, trim, part);
+
+                std::move(part.rows.begin(), part.rows.end(), std::back_inserter(result.rows));
+                if (!ok) {
+                    result.bad_row = done + part.bad_row;
+                    result.bad_size = part.bad_size;
+                    break;
+                }
+
+                pos = next;
+            }
+
+            return result;
+        }
+
+        // Giải mã field mở bằng quote của một record, không qua csv::CSVReader. Trường hợp
+        // lạ (quote giữa field, ký tự sau quote đóng, khoảng trắng hay "" sát quote đóng khi
+        // trim, field cuối rỗng ở cuối file) trả về false để người gọi dùng parser gốc
+        inline bool split_quoted(std::string_view record, char delimiter, bool trim, bool at_eof, Row& row) {
+            auto is_space = [](char ch) { return ch == ' ' || ch == '\t'; };
+
+            std::size_t end = record.size();
+            while (end > 0 && is_newline(record[end - 1]))
+                --end;
+
+            for (std::size_t pos = 0;;) {
+                if (pos < end && record[pos] == '"') {
+                    std::string cell;
+                    for (++pos;;) {
+                        const std::size_t quote = record.find('"', pos);
+                        if (quote >= end)
+                            return false;
+                        cell.append(record.substr(pos, quote - pos));
+                        pos = quote + 1;
+                        if (pos < end && record[pos] == '"') {
+                            cell += '"';
+                            ++pos;
+                            continue;
+                        }
+                        break;
+                    }
+
+                    if ((pos < end && record[pos] != delimiter)
+                        || (trim && !cell.empty() && (is_space(cell.front()) || is_space(cell.back()) || cell.back() == '"')))
+                        return false;
+                    row.push_back(std::move(cell));
+                }
+                else {
+                    const std::size_t next = std::min(record.find(delimiter, pos), end);
+                    auto field = record.substr(pos, next - pos);
+                    if (field.find('"') != std::string_view::npos)
+                        return false;
+                    if (trim) {
+                        while (!field.empty() && is_space(field.front()))
+                            field.remove_prefix(1);
+                        while (!field.empty() && is_space(field.back()))
+                            field.remove_suffix(1);
+                    }
+                    if (next == end && field.empty() && at_eof && end == record.size() && record.back() != delimiter)
+                        return false;
+                    row.emplace_back(field);
+                    pos = next;
+                }
+
+                if (pos >= end)
+                    return true;
+                ++pos; // bỏ qua delimiter
+            }
+        }
+
+        // Parse đúng một record đã cắt bằng next_record: không có quote thì đi split_unquoted
+        // như parse_chunk, có quote thì giải mã tại chỗ, chỉ rơi về parser gốc khi gặp ca lạ
+        inline bool decode_record(
+            std::string_view record,
+            const Row& headers,
+            char delimiter,
+            bool trim,
+            bool at_eof,
+            ChunkResult& result
+        ) {
+            if (record.find('"') == std::string_view::npos)
+                return split_unquoted(record, headers, delimiter, trim, at_eof, result);
+
+            Row row;
+            row.reserve(headers.size());
+            if (!split_quoted(record, delimiter, trim, at_eof, row))
+                return parse_quoted(record, headers, delimiter, trim, result);
+
+            if (row.size() != headers.size()) {
+                result.bad_row = result.rows.size() + 1;
+                result.bad_size = row.size();
+                return false;
+            }
+            result.rows.push_back(std::move(row));
+            return true;
+        }
+
+        inline Row parse_headers(std::string_view record, char delimiter, bool trim, const std::filesystem::path& file) {
+            std::stringstream ss{ std::string(record) };
+            csv::CSVReader reader(ss, make_format(delimiter, trim));
+            return header_row(reader, file);
+        }
+    }
+
+    // Đọc song song: map file, chia thành các chunk cắt đúng ranh giới record
+    // (kể cả khi xuống dòng nằm trong quote), parse đồng thời rồi nối theo thứ tự.
+    // threads = 0 dùng toàn bộ core; file nhỏ sẽ đọc tuần tự như read_csv.
+    // Đoạn không có quote được tách bằng SIMD thay vì parser gốc.
+    inline CSVData read_csv_parallel(
+        const std::filesystem::path& file,
+        char delimiter = ',',
+        bool trim = true,
+        std::size_t threads = 0
+    ) {
+        detail::check_file(file);
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        const std::size_t file_size = std::filesystem::file_size(file);
+        const std::size_t chunk_count = std::min(threads * 4, file_size / detail::PARALLEL_MIN_CHUNK);
+        if (chunk_count < 2)
+            return read_csv(file, delimiter, trim);
+
+        mio::mmap_source source(file.string());
+        const std::string_view text(source.data(), source.size());
+
+        const std::size_t start = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+        const std::size_t header_end = detail::next_record(text, start, delimiter, trim);
+
+        CSVData data;
+        data.set_headers(detail::parse_headers(text.substr(start, header_end - start), delimiter, trim, file), file.string());
+
+        std::vector<std::size_t> bounds{ header_end };
+        const std::size_t step = (text.size() - header_end) / chunk_count;
+        for (std::size_t i = 1; i < chunk_count; ++i) {
+            const std::size_t target = header_end + i * step;
+            if (target <= bounds.back())
+                continue;
+
+            const std::size_t bound = detail::align_record(text, bounds.back(), target, delimiter, trim);
+            if (bound >= text.size())
+                break;
+            bounds.push_back(bound);
+        }
+        bounds.push_back(text.size());
+
+        const std::size_t chunks = bounds.size() - 1;
+        std::vector<detail::ChunkResult> results(chunks);
+        std::atomic<std::size_t> next{ 0 };
+
+        auto worker = [&] {
+            for (std::size_t i = next++; i < chunks; i = next++) {
+                try {
+                    results[i] = detail::parse_chunk(text, bounds[i], bounds[i + 1], data.headers(), delimiter, trim);
+                }
+                catch (...) {
+                    results[i].error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (std::size_t t = 0; t < std::min(threads, chunks); ++t)
+            pool.emplace_back(worker);
+        for (auto& t : pool)
+            t.join();
+
+        std::size_t row_index = 1;
+        for (const auto& result : results) {
+            if (result.error)
+                std::rethrow_exception(result.error);
+            if (result.bad_row)
+                throw detail::integrity_error(row_index + result.bad_row, data.column_count(), result.bad_size);
+            row_index += result.rows.size();
+        }
+
+        data.rows.reserve(row_index - 1);
+        for (auto& result : results)
+            std::move(result.rows.begin(), result.rows.end(), std::back_inserter(data.rows));
+
+        return data;
+    }
+
+    // Một row sai số cột, line đánh số giống read_csv (header là dòng 1)
+    struct RowError {
+        std::size_t line;
+        std::size_t expected;
+        std::size_t actual;
+        std::size_t byte_offset; // vị trí bắt đầu record trong file
+    };
+
+    enum class BadRowPolicy {
+        Skip,      // bỏ row sai
+        Quarantine // bỏ khỏi kết quả nhưng giữ lại trong report.quarantined
+    };
+
+    struct ValidationReport {
+        std::vector<RowError> errors;
+        Rows quarantined; // cùng thứ tự với errors
+
+        bool ok() const {
+            return errors.empty();
+        }
+    };
+
+    namespace detail {
+        // Tìm byte offset của các record theo thứ tự (record 0 là header), chỉ
+        // quét tới record cuối cùng cần tìm
+        inline void locate_records(
+            const std::filesystem::path& file,
+            char delimiter,
+            bool trim,
+            std::vector<RowError>& errors
+        ) {
+            mio::mmap_source source(file.string());
+            const std::string_view text(source.data(), source.size());
+
+            std::size_t pos = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+            std::size_t record = 0;
+
+            for (auto& error : errors) {
+                const std::size_t target = error.line - 1;
+                while (record < target && pos < text.size()) {
+                    pos = next_record(text, pos, delimiter, trim);
+                    ++record;
+                }
+                error.byte_offset = pos;
+            }
+        }
+    }
+
+    // Không throw khi gặp row sai số cột: parse hết file một lần, ghi lại mọi
+    // row sai vào report rồi bỏ qua (hoặc cách ly) chúng
+    inline CSVData read_csv(
+        const std::filesystem::path& file,
+        ValidationReport& report,
+        BadRowPolicy policy = BadRowPolicy::Skip,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        detail::check_file(file);
+
+        csv::CSVReader reader(file.string(), detail::make_format(delimiter, trim));
+
+        CSVData data;
+        data.set_headers(detail::header_row(reader, file), file.string());
+
+        const std::size_t column_count = data.column_count();
+        const std::size_t first_error = report.errors.size();
+        std::size_t row_index = 1;
+
+        for (auto& row : reader) {
+            ++row_index;
+
+            const RowView view(row, data.headers(), row_index);
+            if (row.size() == column_count) {
+                data.rows.push_back(view.to_row());
+                continue;
+            }
+
+            report.errors.push_back({ row_index, column_count, row.size(), 0 });
+            if (policy == BadRowPolicy::Quarantine)
+                report.quarantined.push_back(view.to_row());
+        }
+
+        // Byte offset chỉ cần khi có lỗi nên tính ở lượt quét nhẹ thứ hai
+        if (report.errors.size() > first_error) {
+            std::vector<RowError> found(report.errors.begin() + first_error, report.errors.end());
+            detail::locate_records(file, delimiter, trim, found);
+            std::copy(found.begin(), found.end(), report.errors.begin() + first_error);
+        }
+
+        return data;
+    }
+
+    // Chính sách đẩy dữ liệu xuống đĩa khi ghi nối
+    enum class FlushPolicy {
+        None,  // giữ trong buffer tới khi flush() hoặc hủy đối tượng
+        Flush, // gọi write() sau mỗi row
+        Sync   // write() rồi fsync() sau mỗi row
+    };
+
+    namespace detail {
+        enum class OpenMode {
+            Read, Append, Truncate, Create // Create: tạo mới, lỗi nếu file đã tồn tại
+        };
+
+        // unknown: file mới tạo nhận 0644 (sau umask), file tạm của create_temp nhận
+        // lại quyền của file đích nếu đã có
+        constexpr auto DEFAULT_PERMS = std::filesystem::perms::unknown;
+
+        // Bọc file descriptor để có thể fsync, thứ mà std::ofstream không cho.
+        // perms khác unknown thì file (kể cả file đã có) được đặt đúng quyền đó;
+        // trên Windows chỉ có quyền đọc/ghi nên perms bị bỏ qua
+        class File {
+            int _fd = -1;
+            std::filesystem::path _path;
+
+        public:
+            File(const std::filesystem::path& path, OpenMode mode, std::filesystem::perms perms = DEFAULT_PERMS) : _path(path) {
+#ifdef _WIN32
+                int flags = _O_BINARY;
+                switch (mode) {
+                    case OpenMode::Read:     flags |= _O_RDONLY; break;
+                    case OpenMode::Append:   flags |= _O_WRONLY | _O_APPEND | _O_CREAT; break;
+                    case OpenMode::Truncate: flags |= _O_WRONLY | _O_TRUNC | _O_CREAT; break;
+                    case OpenMode::Create:   flags |= _O_WRONLY | _O_CREAT | _O_EXCL; break;
+                }
+                _fd = ::_wopen(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+                (void)perms;
+#else
+                int flags = O_CLOEXEC;
+                switch (mode) {
+                    case OpenMode::Read:     flags |= O_RDONLY; break;
+                    case OpenMode::Append:   flags |= O_WRONLY | O_APPEND | O_CREAT; break;
+                    case OpenMode::Truncate: flags |= O_WRONLY | O_TRUNC | O_CREAT; break;
+                    case OpenMode::Create:   flags |= O_WRONLY | O_CREAT | O_EXCL; break;
+                }
+                const bool explicit_perms = perms != std::filesystem::perms::unknown;
+                const auto bits = explicit_perms ? static_cast<mode_t>(perms & std::filesystem::perms::mask) : mode_t{ 0644 };
+                _fd = ::open(path.c_str(), flags, bits);
+                if (_fd >= 0 && mode != OpenMode::Read && explicit_perms && ::fchmod(_fd, bits) != 0) {
+                    close();
+                    throw std::runtime_error("Failed to set permissions: " + path.string());
+                }
+#endif
+                if (_fd < 0)
+                    throw std::runtime_error("Failed to open file: " + path.string());
+            }
+
+            File(File&& other) noexcept : _fd(other._fd), _path(std::move(other._path)) {
+                other._fd = -1;
+            }
+
+            File(const File&) = delete;
+            File& operator=(const File&) = delete;
+            File& operator=(File&&) = delete;
+
+            ~File() {
+                close();
+            }
+
+            int fd() const {
+                return _fd;
+            }
+
+            void write(std::string_view bytes) {
+                while (!bytes.empty()) {
+#ifdef _WIN32
+                    const int chunk = static_cast<int>(std::min<std::size_t>(bytes.size(), 1 << 30));
+                    const int written = ::_write(_fd, bytes.data(), chunk);
+#else
+                    const ssize_t written = ::write(_fd, bytes.data(), bytes.size());
+                    if (written < 0 && errno == EINTR)
+                        continue;
+#endif
+                    if (written < 0)
+                        throw std::runtime_error("Failed to write file: " + _path.string());
+                    bytes.remove_prefix(static_cast<std::size_t>(written));
+                }
+            }
+
+            void sync() {
+#ifdef _WIN32
+                const int rc = ::_commit(_fd);
+#else
+                const int rc = ::fsync(_fd);
+#endif
+                if (rc != 0)
+                    throw std::runtime_error("Failed to sync file: " + _path.string());
+            }
+
+            void close() {
+                if (_fd < 0)
+                    return;
+#ifdef _WIN32
+                ::_close(_fd);
+#else
+                ::close(_fd);
+#endif
+                _fd = -1;
+            }
+        };
+
+        // Field có cần bọc quote không: kiểm tra 16 byte một lần bằng SSE2
+        inline bool needs_quote(std::string_view field, char delimiter) {
+            const char* p = field.data();
+            const char* end = p + field.size();
+
+#if UTILITY_CSV_X86
+            const __m128i q = _mm_set1_epi8('"');
+            const __m128i d = _mm_set1_epi8(delimiter);
+            const __m128i lf = _mm_set1_epi8('\n');
+            const __m128i cr = _mm_set1_epi8('\r');
+
+            for (; end - p >= 16; p += 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                const __m128i hit = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, d)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))
+                );
+                if (_mm_movemask_epi8(hit) != 0)
+                    return true;
+            }
+#endif
+
+            for (; p != end; ++p)
+                if (*p == '"' || *p == delimiter || *p == '\r' || *p == '\n')
+                    return true;
+            return false;
+        }
+
+        // Định dạng giống csv::DelimWriter (quote khi cần) nhưng ghi thẳng vào
+        // buffer dùng lại, không tạo std::string cho từng field
+        inline void append_field(std::string& out, std::string_view field, char delimiter) {
+            if (!needs_quote(field, delimiter)) {
+                out += field;
+                return;
+            }
+
+            out += '"';
+            for (std::size_t pos = 0;;) {
+                const std::size_t quote = field.find('"', pos);
+                if (quote == std::string_view::npos) {
+                    out += field.substr(pos);
+                    break;
+                }
+                out += field.substr(pos, quote + 1 - pos);
+                out += '"';
+                pos = quote + 1;
+            }
+            out += '"';
+        }
+
+        // Record không được rỗng: dòng trống bị reader bỏ qua, nên một cell rỗng duy nhất
+        // được ghi thành "" (row rỗng bị chặn trước khi tới đây)
+        inline void append_row(std::string& out, const Row& row, char delimiter = ',') {
+            if (row.size() == 1 && row[0].empty()) {
+                out += "\"\"\n";
+                return;
+            }
+
+            for (std::size_t i = 0; i < row.size(); ++i) {
+                if (i != 0)
+                    out += delimiter;
+                append_field(out, row[i], delimiter);
+            }
+            out += '\n';
+        }
+    }
+
+    // Ghi nối row vào cuối file CSV đang có, không viết lại cả file.
+    // Header của file phải khớp với headers; file chưa có thì tạo mới kèm header.
+    class CSVAppender {
+        std::string _buffer; // khai báo trước _file vì open() ghi header vào đây
+        detail::File _file;
+        std::size_t _column_count;
+        FlushPolicy _policy;
+        char _delimiter;
+
+        static constexpr std::size_t BUFFER_LIMIT = 1 << 16;
+
+        static detail::File open(
+            const std::filesystem::path& file,
+            const Row& headers,
+            std::string& pending,
+            char delimiter,
+            bool trim,
+            std::filesystem::perms perms
+        ) {
+            if (headers.empty())
+                throw std::runtime_error("CSV has no headers");
+
+            const bool fresh = !std::filesystem::exists(file) || std::filesystem::file_size(file) == 0;
+            if (fresh) {
+                detail::append_row(pending, headers, delimiter);
+                return detail::File(file, detail::OpenMode::Append, perms);
+            }
+
+            {
+                mio::mmap_source source(file.string());
+                const std::string_view text(source.data(), source.size());
+
+                const std::size_t start = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+                const std::size_t header_end = detail::next_record(text, start, delimiter, trim);
+                if (detail::parse_headers(text.substr(start, header_end - start), delimiter, trim, file) != headers)
+                    throw std::runtime_error("CSV header mismatch: " + file.string());
+
+                if (!detail::is_newline(text.back()))
+                    pending += '\n';
+            }
+
+            return detail::File(file, detail::OpenMode::Append, perms);
+        }
+
+    public:
+        // delimiter / trim theo dialect của file đang có, giống read_csv.
+        // perms khác unknown thì file được đặt đúng quyền đó (vd. owner_read | owner_write cho dữ liệu nhạy cảm)
+        CSVAppender(
+            const std::filesystem::path& file,
+            const Row& headers,
+            FlushPolicy policy = FlushPolicy::Flush,
+            char delimiter = ',',
+            bool trim = true,
+            std::filesystem::perms perms = detail::DEFAULT_PERMS
+        ) : _file(open(file, headers, _buffer, delimiter, trim, perms)),
+            _column_count(headers.size()),
+            _policy(policy),
+            _delimiter(delimiter) {
+            if (_policy != FlushPolicy::None)
+                flush();
+        }
+
+        CSVAppender(const CSVAppender&) = delete;
+        CSVAppender& operator=(const CSVAppender&) = delete;
+
+        ~CSVAppender() {
+            try {
+                flush();
+            }
+            catch (...) {
+            }
+        }
+
+        void append(const Row& row) {
+            if (row.size() > _column_count)
+                throw std::runtime_error("Row has more columns than header");
+            if (row.empty())
+                throw std::runtime_error("Row is empty");
+
+            detail::append_row(_buffer, row, _delimiter);
+
+            if (_policy == FlushPolicy::Sync)
+                sync();
+            else if (_policy == FlushPolicy::Flush || _buffer.size() >= BUFFER_LIMIT)
+                flush();
+        }
+
+        void flush() {
+            if (_buffer.empty())
+                return;
+            _file.write(_buffer);
+            _buffer.clear();
+        }
+
+        void sync() {
+            flush();
+            _file.sync();
+        }
+    };
+
+    inline void append_csv(
+        const std::filesystem::path& filename,
+        const CSVData& data,
+        FlushPolicy policy = FlushPolicy::Flush,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        CSVAppender appender(filename, data.headers(), FlushPolicy::None, delimiter, trim);
+        for (const auto& row : data.rows)
+            appender.append(row);
+
+        if (policy == FlushPolicy::Sync)
+            appender.sync();
+        else
+            appender.flush();
+    }
+
+    struct WriteOptions {
+        bool atomic = true;      // ghi ra file tạm cạnh file đích, fsync rồi rename đè lên
+        std::size_t threads = 1; // > 1 thì định dạng các nhóm row song song, 0 là dùng toàn bộ core
+        std::string index_column = {}; // khác rỗng thì ghi kèm file .idx theo cột này (xem CSVIndex)
+        std::string bloom_column = {}; // khác rỗng thì ghi kèm file .bloom theo cột này (xem BloomFilter)
+        double bloom_fp_rate = 0.01;
+        bool allow_empty = false; // cho phép ghi file chỉ có header, không có row nào
+        // Quyền của file đích; unknown là giữ quyền của file cũ, file mới là 0644
+        std::filesystem::perms permissions = std::filesystem::perms::unknown;
+    };
+
+    namespace detail {
+        inline void validate_csv(const CSVData& data, bool allow_empty = false) {
+            if (data.empty() && !allow_empty)
+                throw std::runtime_error("CSV headers are empty");
+            
+            const std::size_t column_count = data.column_count();
+            if (column_count == 0) 
+                throw std::runtime_error("CSV has no headers");
+
+            for (const auto& r : data.rows) {
+                if (r.size() > column_count)
+                    throw std::runtime_error("Row has more columns than header");
+                if (r.empty())
+                    throw std::runtime_error("Row is empty");
+            }
+        }
+
+        constexpr std::size_t WRITE_BUFFER = 1 << 20;
+        constexpr std::size_t PARALLEL_MIN_ROWS = 1 << 14;
+
+        // Chia rows thành nhiều nhóm, mỗi worker định dạng một nhóm vào buffer riêng.
+        // Luồng gọi ghi các nhóm theo đúng thứ tự ngay khi nhóm đó xong rồi giải phóng buffer,
+        // worker chỉ được đi trước nhóm đang chờ ghi một cửa sổ cố định nên bộ nhớ không phụ thuộc
+        // kích thước file. Kết quả giống hệt bản tuần tự
+        inline void write_parallel(File& out, const CSVData& data, std::size_t threads) {
+            const std::size_t chunks = std::min(threads * 4, (data.rows.size() + PARALLEL_MIN_ROWS - 1) / PARALLEL_MIN_ROWS);
+            const std::size_t per_chunk = (data.rows.size() + chunks - 1) / chunks;
+            const std::size_t window = 2 * threads;
+
+            std::vector<std::string> parts(chunks);
+            std::vector<std::exception_ptr> errors(chunks);
+            std::vector<char> ready(chunks, 0);
+
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::size_t next = 0;
+            std::size_t written = 0;
+            bool stop = false;
+
+            auto worker = [&] {
+                for (;;) {
+                    std::size_t i;
+                    {
+                        std::unique_lock lock(mutex);
+                        changed.wait(lock, [&] { return stop || next == chunks || next < written + window; });
+                        if (stop || next == chunks)
+                            return;
+                        i = next++;
+                    }
+
+                    try {
+                        const std::size_t begin = i * per_chunk;
+                        const std::size_t end = std::min(begin + per_chunk, data.rows.size());
+
+                        auto& part = parts[i];
+                        part.reserve((end - begin) * 64);
+                        for (std::size_t r = begin; r < end; ++r)
+                            append_row(part, data.rows[r]);
+                    }
+                    catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+
+                    {
+                        std::lock_guard lock(mutex);
+                        ready[i] = 1;
+                    }
+                    changed.notify_all();
+                }
+            };
+
+            std::vector<std::thread> pool;
+            auto join_all = [&] {
+                {
+                    std::lock_guard lock(mutex);
+                    stop = true;
+                }
+                changed.notify_all();
+                for (auto& t : pool)
+                    t.join();
+            };
+
+            try {
+                for (std::size_t t = 0; t < std::min(threads, chunks); ++t)
+                    pool.emplace_back(worker);
+
+                std::string header;
+                append_row(header, data.headers());
+                out.write(header);
+
+                for (std::size_t i = 0; i < chunks; ++i) {
+                    {
+                        std::unique_lock lock(mutex);
+                        changed.wait(lock, [&] { return ready[i] != 0; });
+                    }
+                    if (errors[i])
+                        std::rethrow_exception(errors[i]);
+
+                    out.write(parts[i]);
+                    std::string().swap(parts[i]);
+
+                    {
+                        std::lock_guard lock(mutex);
+                        ++written;
+                    }
+                    changed.notify_all();
+                }
+            }
+            catch (...) {
+                join_all();
+                throw;
+            }
+            join_all();
+        }
+
+        // Định dạng vào một buffer 1MB dùng lại suốt quá trình ghi,
+        // mỗi lần đầy mới gọi write() một lần
+        inline void write_file(
+            File& out,
+            const CSVData& data,
+            bool sync = false,
+            std::size_t threads = 1
+        ) {
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+
+            if (threads > 1 && data.rows.size() >= 2 * PARALLEL_MIN_ROWS) {
+                write_parallel(out, data, threads);
+            }
+            else {
+                std::string buffer;
+                buffer.reserve(WRITE_BUFFER + (1 << 12));
+
+                append_row(buffer, data.headers());
+                for (const auto& row : data.rows) {
+                    append_row(buffer, row);
+                    if (buffer.size() >= WRITE_BUFFER) {
+                        out.write(buffer);
+                        buffer.clear();
+                    }
+                }
+
+                out.write(buffer);
+            }
+
+            if (sync)
+                out.sync();
+        }
+
+        // Tạo file tạm tên ngẫu nhiên cạnh filename bằng O_EXCL (như mkstemp) để không
+        // đụng file tạm của tiến trình khác hay đi theo symlink có sẵn.
+        // perms là unknown thì file tạm nhận lại quyền của filename (nếu đã có) để rename
+        // không đổi quyền; khác unknown thì file tạm được tạo thẳng với quyền đó.
+        inline File create_temp(
+            const std::filesystem::path& filename,
+            std::filesystem::path& tmp,
+            std::filesystem::perms perms = DEFAULT_PERMS
+        ) {
+            thread_local std::mt19937_64 rng(std::random_device{}());
+
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                char suffix[20];
+                const int n = std::snprintf(suffix, sizeof(suffix), ".%016llx", static_cast<unsigned long long>(rng()));
+
+                auto candidate = filename;
+                candidate += std::string_view(suffix, static_cast<std::size_t>(n));
+                candidate += ".tmp";
+
+                std::error_code ec;
+                if (std::filesystem::symlink_status(candidate, ec).type() != std::filesystem::file_type::not_found)
+                    continue;
+
+                std::optional<File> out;
+                try {
+                    out.emplace(candidate, OpenMode::Create, perms);
+                }
+                catch (const std::runtime_error&) {
+                    // Tiến trình khác vừa tạo đúng tên này thì thử tên khác
+                    if (std::filesystem::symlink_status(candidate, ec).type() == std::filesystem::file_type::not_found)
+                        throw;
+                    continue;
+                }
+
+#ifndef _WIN32
+                struct stat st;
+                if (perms == std::filesystem::perms::unknown && ::stat(filename.c_str(), &st) == 0
+                    && ::fchmod(out->fd(), st.st_mode & 07777) != 0) {
+                    out->close();
+                    std::filesystem::remove(candidate, ec);
+                    throw std::runtime_error("Failed to set permissions: " + candidate.string());
+                }
+#endif
+                tmp = std::move(candidate);
+                return std::move(*out);
+            }
+
+            throw std::runtime_error("Failed to create temp file for: " + filename.string());
+        }
+
+        inline void sync_file(const std::filesystem::path& file) {
+#ifdef _WIN32
+            File(file, OpenMode::Append).sync(); // _commit cần quyền ghi
+#else
+            File(file, OpenMode::Read).sync();
+#endif
+        }
+
+        // Sau rename phải fsync thư mục thì entry mới chắc chắn nằm trên đĩa
+        inline void sync_directory(const std::filesystem::path& file) {
+#ifndef _WIN32
+            auto dir = file.parent_path();
+            if (dir.empty())
+                dir = ".";
+
+            const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                throw std::runtime_error("Failed to open directory: " + dir.string());
+
+            const int rc = ::fsync(fd);
+            ::close(fd);
+            if (rc != 0)
+                throw std::runtime_error("Failed to sync directory: " + dir.string());
+#else
+            (void)file;
+#endif
+        }
+    }
+
+    namespace detail {
+        inline void write_index(const std::filesystem::path& csv_file, const CSVData& data, std::string_view key_column);
+        inline void write_bloom(const std::filesystem::path& csv_file, const CSVData& data, std::string_view key_column, double fp_rate);
+
+        inline void write_sidecars(const std::filesystem::path& csv_file, const CSVData& data, const WriteOptions& options) {
+            if (!options.index_column.empty())
+                write_index(csv_file, data, options.index_column);
+            if (!options.bloom_column.empty())
+                write_bloom(csv_file, data, options.bloom_column, options.bloom_fp_rate);
+        }
+    }
+
+    inline void write_csv(
+        const std::filesystem::path& filename,
+        const CSVData& data,
+        const WriteOptions& options = {}
+    ) {
+        detail::validate_csv(data, options.allow_empty);
+
+        if (!options.atomic) {
+            {
+                detail::File out(filename, detail::OpenMode::Truncate, options.permissions);
+                detail::write_file(out, data, false, options.threads);
+            }
+            detail::write_sidecars(filename, data, options);
+            return;
+        }
+
+        std::filesystem::path tmp;
+        auto out = detail::create_temp(filename, tmp, options.permissions);
+        try {
+            detail::write_file(out, data, true, options.threads);
+            out.close();
+            std::filesystem::rename(tmp, filename);
+        }
+        catch (...) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            throw;
+        }
+
+        detail::sync_directory(filename);
+        detail::write_sidecars(filename, data, options);
+    }
+
+    // Gom nhiều lần lưu thành một lần commit: file lưu nhiều lần chỉ ghi bản cuối,
+    // mỗi file fsync một lần và mỗi thư mục fsync một lần.
+    // Hủy đối tượng khi chưa commit() thì bỏ hết các thay đổi.
+    // Mỗi file mang WriteOptions riêng như write_csv (quyền, allow_empty, index/bloom),
+    // riêng atomic bị bỏ qua vì commit luôn ghi qua file tạm rồi rename
+    class SaveBatch {
+        struct Entry {
+            std::filesystem::path path;
+            CSVData data;
+            WriteOptions options;
+        };
+        std::vector<Entry> _pending;
+
+    public:
+        void save(const std::filesystem::path& filename, CSVData data, WriteOptions options = {}) {
+            detail::validate_csv(data, options.allow_empty);
+
+            for (auto& pending : _pending) {
+                if (pending.path == filename) {
+                    pending.data = std::move(data);
+                    pending.options = std::move(options);
+                    return;
+                }
+            }
+
+            _pending.push_back({ filename, std::move(data), std::move(options) });
+        }
+
+        std::size_t size() const {
+            return _pending.size();
+        }
+
+        void discard() {
+            _pending.clear();
+        }
+
+        void commit() {
+            std::vector<std::filesystem::path> temps;
+            temps.reserve(_pending.size());
+
+            std::size_t renamed = 0;
+            try {
+                for (const auto& [path, data, options] : _pending) {
+                    std::filesystem::path tmp;
+                    auto out = detail::create_temp(path, tmp, options.permissions);
+                    temps.push_back(std::move(tmp));
+                    detail::write_file(out, data, false, options.threads);
+                }
+
+                for (const auto& tmp : temps)
+                    detail::sync_file(tmp);
+
+                for (; renamed < temps.size(); ++renamed)
+                    std::filesystem::rename(temps[renamed], _pending[renamed].path);
+            }
+            catch (...) {
+                std::error_code ec;
+                for (std::size_t i = renamed; i < temps.size(); ++i)
+                    std::filesystem::remove(temps[i], ec);
+                throw;
+            }
+
+            std::vector<std::filesystem::path> dirs;
+            for (const auto& entry : _pending) {
+                auto dir = entry.path.parent_path();
+                if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+                    dirs.push_back(dir);
+                    detail::sync_directory(entry.path);
+                }
+            }
+
+            // Index/bloom ghi sau cùng, khi file CSV đã ở chỗ và stamp của nó không còn đổi
+            auto pending = std::move(_pending);
+            _pending.clear();
+            for (const auto& [path, data, options] : pending)
+                detail::write_sidecars(path, data, options);
+        }
+    };
+
+    namespace detail {
+        inline std::uint64_t fnv1a(std::string_view bytes, std::uint64_t hash = 14695981039346656037ull) {
+            for (unsigned char ch : bytes) {
+                hash ^= ch;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        // Ghi cả khối bytes ra file tạm, fsync rồi rename, giống write_csv
+        inline void write_atomic(
+            const std::filesystem::path& filename,
+            std::string_view bytes,
+            std::filesystem::perms perms = DEFAULT_PERMS
+        ) {
+            std::filesystem::path tmp;
+            auto out = create_temp(filename, tmp, perms);
+            try {
+                out.write(bytes);
+                out.sync();
+                out.close();
+                std::filesystem::rename(tmp, filename);
+            }
+            catch (...) {
+                out.close();
+                std::error_code ec;
+                std::filesystem::remove(tmp, ec);
+                throw;
+            }
+
+            sync_directory(filename);
+        }
+
+        // Dấu vết của file nguồn để biết file phụ (snapshot, index...) còn dùng được không
+        struct FileStamp {
+            std::uint64_t size = 0;
+            std::int64_t mtime = 0;
+
+            bool operator==(const FileStamp&) const = default;
+        };
+
+        inline FileStamp stamp(const std::filesystem::path& file) {
+            return {
+                static_cast<std::uint64_t>(std::filesystem::file_size(file)),
+                static_cast<std::int64_t>(std::filesystem::last_write_time(file).time_since_epoch().count())
+            };
+        }
+
+        template <typename T>
+        T load(const char* p) {
+            T value;
+            std::memcpy(&value, p, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void store(std::string& out, T value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        // Header cố định 64 byte ở đầu file snapshot
+        struct SnapshotHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t endian;
+            std::uint64_t source_size;
+            std::int64_t source_mtime;
+            std::uint64_t row_count;
+            std::uint64_t column_count;
+            std::uint64_t string_count;
+            std::uint64_t checksum; // FNV-1a của id header cột, bảng offset chuỗi và các byte chuỗi
+        };
+        static_assert(sizeof(SnapshotHeader) == 64);
+
+        constexpr char SNAPSHOT_MAGIC[8] = { 'D', 'D', 'S', 'N', 'A', 'P', 0, 0 };
+        constexpr std::uint32_t SNAPSHOT_VERSION = 3;
+        constexpr std::uint32_t SNAPSHOT_ENDIAN = 0x01020304;
+
+        inline std::size_t align8(std::size_t n) {
+            return (n + 7) & ~std::size_t{ 7 };
+        }
+
+        // Băm id header cột, bảng offset chuỗi và các byte chuỗi (liền nhau tới hết file) nên
+        // chuỗi bị sửa cũng bị phát hiện. Bảng id của record, phần lớn nhất, không được băm
+        // để open() khỏi đọc hết file: id trong record chỉ được kiểm tra biên lúc truy cập,
+        // nên record hỏng không đọc ra ngoài vùng map nhưng có thể trỏ sang chuỗi khác.
+        inline std::uint64_t snapshot_checksum(std::string_view body, std::size_t columns, std::size_t offsets_at) {
+            const auto hash = fnv1a(body.substr(0, 4 * columns));
+            return fnv1a(body.substr(offsets_at), hash);
+        }
+
+        // Bố cục sau header: id chuỗi của header (uint32 x cột), record cố định
+        // (uint32 x cột x row), bảng offset chuỗi (uint64, canh 8 byte), cuối cùng là các byte chuỗi
+        inline std::string serialize_snapshot(const CSVData& data, const FileStamp& source) {
+            std::unordered_map<std::string_view, std::uint32_t> ids;
+            std::vector<std::string_view> strings;
+
+            auto intern = [&](std::string_view str) {
+                auto [it, inserted] = ids.try_emplace(str, static_cast<std::uint32_t>(strings.size()));
+                if (inserted) {
+                    if (strings.size() == std::numeric_limits<std::uint32_t>::max())
+                        throw std::runtime_error("Snapshot string table overflow");
+                    strings.push_back(str);
+                }
+                return it->second;
+            };
+
+            const std::size_t column_count = data.column_count();
+
+            std::string body;
+            body.reserve(4 * column_count * (data.rows.size() + 1));
+
+            for (const auto& header : data.headers())
+                store(body, intern(header));
+
+            for (const auto& row : data.rows)
+                for (std::size_t c = 0; c < column_count; ++c)
+                    store(body, intern(c < row.size() ? std::string_view(row[c]) : std::string_view()));
+
+            body.resize(align8(sizeof(SnapshotHeader) + body.size()) - sizeof(SnapshotHeader), '\0');
+
+            std::uint64_t offset = 0;
+            for (auto str : strings) {
+                store(body, offset);
+                offset += str.size();
+            }
+            store(body, offset);
+
+            const std::size_t offsets_at = body.size() - 8 * (strings.size() + 1);
+
+            for (auto str : strings)
+                body += str;
+
+            SnapshotHeader header{};
+            std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+            header.version = SNAPSHOT_VERSION;
+            header.endian = SNAPSHOT_ENDIAN;
+            header.source_size = source.size;
+            header.source_mtime = source.mtime;
+            header.row_count = data.rows.size();
+            header.column_count = column_count;
+            header.string_count = strings.size();
+            header.checksum = snapshot_checksum(body, column_count, offsets_at);
+
+            std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+            bytes += body;
+            return bytes;
+        }
+    }
+
+    inline std::filesystem::path snapshot_path(const std::filesystem::path& csv_file) {
+        auto path = csv_file;
+        path += ".snap";
+        return path;
+    }
+
+    // Snapshot nhị phân của một file CSV, được map thẳng vào bộ nhớ và đọc
+    // không cần parse. Cell trả về là string_view vào vùng map.
+    class Snapshot {
+        mio::mmap_source _map;
+        std::vector<char> _owned;
+        std::string_view _bytes;
+
+        std::size_t _rows = 0;
+        std::size_t _columns = 0;
+        std::size_t _strings = 0;
+        const char* _ids = nullptr;     // header rồi tới các record
+        const char* _offsets = nullptr;
+        const char* _blob = nullptr;
+        std::uint64_t _blob_size = 0;
+
+        Snapshot() = default;
+
+        // Kiểm tra header, kích thước và checksum; sai ở đâu cũng coi như không có snapshot
+        bool attach(std::string_view bytes, const detail::FileStamp* source) {
+            using detail::SnapshotHeader;
+
+            if (bytes.size() < sizeof(SnapshotHeader))
+                return false;
+
+            SnapshotHeader header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+
+            if (std::memcmp(header.magic, detail::SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+                || header.version != detail::SNAPSHOT_VERSION
+                || header.endian != detail::SNAPSHOT_ENDIAN)
+                return false;
+
+            if (source && (header.source_size != source->size || header.source_mtime != source->mtime))
+                return false;
+
+            const std::uint64_t limit = bytes.size();
+            if (header.column_count == 0 || header.column_count > limit
+                || header.row_count > limit || header.string_count > limit)
+                return false;
+
+            if (header.row_count + 1 > limit / 4 / header.column_count)
+                return false;
+
+            const std::uint64_t cells = (header.row_count + 1) * header.column_count;
+
+            const std::size_t offsets_at = detail::align8(sizeof(SnapshotHeader) + cells * 4);
+            const std::size_t blob_at = offsets_at + (header.string_count + 1) * 8;
+            if (blob_at > limit)
+                return false;
+
+            const auto blob_size = detail::load<std::uint64_t>(bytes.data() + blob_at - 8);
+            if (blob_at + blob_size != limit)
+                return false;
+
+            const auto body = bytes.substr(sizeof(SnapshotHeader));
+            const auto checksum = detail::snapshot_checksum(body, header.column_count, offsets_at - sizeof(SnapshotHeader));
+            if (checksum != header.checksum)
+                return false;
+
+            _bytes = bytes;
+            _rows = header.row_count;
+            _columns = header.column_count;
+            _strings = header.string_count;
+            _ids = bytes.data() + sizeof(SnapshotHeader);
+            _offsets = bytes.data() + offsets_at;
+            _blob = bytes.data() + blob_at;
+            _blob_size = blob_size;
+            return true;
+        }
+
+        std::string_view string(std::uint32_t id) const {
+            if (id >= _strings)
+                throw std::runtime_error("Snapshot is corrupt");
+
+            const auto begin = detail::load<std::uint64_t>(_offsets + 8 * std::size_t{ id });
+            const auto end = detail::load<std::uint64_t>(_offsets + 8 * (std::size_t{ id } + 1));
+            if (begin > end || end > _blob_size)
+                throw std::runtime_error("Snapshot is corrupt");
+            return std::string_view(_blob + begin, end - begin);
+        }
+
+    public:
+        Snapshot(Snapshot&&) = default;
+        Snapshot& operator=(Snapshot&&) = default;
+
+        // Map file .snap cạnh csv_file; trả về nullopt nếu thiếu, cũ hơn file CSV hoặc hỏng
+        static std::optional<Snapshot> open(const std::filesystem::path& csv_file) {
+            const auto path = snapshot_path(csv_file);
+
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(path, ec) || !std::filesystem::exists(csv_file, ec))
+                return std::nullopt;
+
+            const auto source = detail::stamp(csv_file);
+
+            Snapshot snapshot;
+            snapshot._map.map(path.string(), ec);
+            if (ec)
+                return std::nullopt;
+
+            if (!snapshot.attach(std::string_view(snapshot._map.data(), snapshot._map.size()), &source))
+                return std::nullopt;
+
+            return snapshot;
+        }
+
+        // Dùng snapshot nếu còn mới, không thì đọc CSV và ghi lại snapshot cho lần sau
+        static Snapshot load(const std::filesystem::path& csv_file, char delimiter = ',', bool trim = true) {
+            if (auto snapshot = open(csv_file))
+                return std::move(*snapshot);
+
+            detail::check_file(csv_file);
+            const auto source = detail::stamp(csv_file);
+            const auto bytes = detail::serialize_snapshot(read_csv(csv_file, delimiter, trim), source);
+            detail::write_atomic(snapshot_path(csv_file), bytes);
+
+            Snapshot snapshot;
+            snapshot._owned.assign(bytes.begin(), bytes.end());
+            snapshot.attach(std::string_view(snapshot._owned.data(), snapshot._owned.size()), nullptr);
+            return snapshot;
+        }
+
+        std::size_t row_count() const {
+            return _rows;
+        }
+
+        std::size_t column_count() const {
+            return _columns;
+        }
+
+        bool empty() const {
+            return _rows == 0;
+        }
+
+        std::string_view header(std::size_t column) const {
+            return string(detail::load<std::uint32_t>(_ids + 4 * column));
+        }
+
+        std::string_view cell(std::size_t row, std::size_t column) const {
+            return string(detail::load<std::uint32_t>(_ids + 4 * ((row + 1) * _columns + column)));
+        }
+
+        Row headers() const {
+            Row r;
+            for (std::size_t c = 0; c < _columns; ++c)
+                r.emplace_back(header(c));
+            return r;
+        }
+
+        CSVData to_csv_data() const {
+            CSVData data(headers());
+            data.rows.reserve(_rows);
+            for (std::size_t r = 0; r < _rows; ++r) {
+                Row row;
+                row.reserve(_columns);
+                for (std::size_t c = 0; c < _columns; ++c)
+                    row.emplace_back(cell(r, c));
+                data.rows.push_back(std::move(row));
+            }
+            return data;
+        }
+    };
+
+    inline void write_snapshot(const std::filesystem::path& csv_file, const CSVData& data) {
+        detail::write_atomic(snapshot_path(csv_file), detail::serialize_snapshot(data, detail::stamp(csv_file)));
+    }
+
+    namespace detail {
+        // Header cố định 64 byte ở đầu file index
+        struct IndexHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t endian;
+            std::uint64_t source_size;
+            std::int64_t source_mtime;
+            std::uint64_t entry_count;
+            std::uint32_t key_column;
+            char delimiter;
+            std::uint8_t trim;
+            std::uint16_t reserved;
+            std::uint64_t checksum; // FNV-1a của toàn bộ phần sau header
+            std::uint64_t reserved2;
+        };
+        static_assert(sizeof(IndexHeader) == 64);
+
+        // Một row trong bảng, bảng sắp theo key rồi theo vị trí trong file
+        struct IndexEntry {
+            std::uint64_t key_offset; // vào vùng key phía sau bảng
+            std::uint32_t key_size;
+            std::uint32_t reserved;
+            std::uint64_t record_offset; // byte bắt đầu record trong file CSV
+        };
+        static_assert(sizeof(IndexEntry) == 24);
+
+        // Chỉ parse record header của file, không đọc phần còn lại
+        inline Row load_headers(const std::filesystem::path& csv_file, char delimiter, bool trim) {
+            mio::mmap_source source(csv_file.string());
+            const std::string_view text(source.data(), source.size());
+
+            const std::size_t start = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+            const std::size_t end = next_record(text, start, delimiter, trim);
+            return parse_headers(text.substr(start, end - start), delimiter, trim, csv_file);
+        }
+
+        constexpr char INDEX_MAGIC[8] = { 'D', 'D', 'I', 'N', 'D', 'E', 'X', 0 };
+        constexpr std::uint32_t INDEX_VERSION = 1;
+
+        // Byte offset của từng record dữ liệu (bỏ header), cùng luật tách record với read_csv
+        inline std::vector<std::uint64_t> record_offsets(std::string_view text, char delimiter, bool trim) {
+            std::size_t pos = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+            pos = next_record(text, pos, delimiter, trim);
+
+            std::vector<std::uint64_t> offsets;
+            while (pos < text.size()) {
+                offsets.push_back(pos);
+                pos = next_record(text, pos, delimiter, trim);
+            }
+            return offsets;
+        }
+
+        inline std::string serialize_index(
+            const CSVData& data,
+            std::size_t key_column,
+            const std::vector<std::uint64_t>& offsets,
+            char delimiter,
+            bool trim,
+            const FileStamp& source
+        ) {
+            if (offsets.size() != data.rows.size())
+                throw std::runtime_error("CSV index does not match file contents");
+
+            // Row ngắn hơn header thì cell khóa thiếu được coi là rỗng, giống read_csv_as
+            auto key = [&](std::size_t r) {
+                const auto& row = data.rows[r];
+                return key_column < row.size() ? std::string_view(row[key_column]) : std::string_view();
+            };
+
+            std::vector<std::size_t> order(data.rows.size());
+            for (std::size_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+                return key(a) < key(b);
+            });
+
+            std::string body(order.size() * sizeof(IndexEntry), '\0');
+            std::string keys;
+            std::uint64_t key_offset = 0;
+
+            for (std::size_t i = 0; i < order.size(); ++i) {
+                const auto value = key(order[i]);
+                if (value.size() > std::numeric_limits<std::uint32_t>::max())
+                    throw std::runtime_error("CSV index key is too long");
+
+                // Key trùng nhau (một sinh viên nhiều dòng) chỉ lưu một lần
+                if (i == 0 || value != key(order[i - 1])) {
+                    key_offset = keys.size();
+                    keys += value;
+                }
+
+                const IndexEntry entry{ key_offset, static_cast<std::uint32_t>(value.size()), 0, offsets[order[i]] };
+                std::memcpy(body.data() + i * sizeof(IndexEntry), &entry, sizeof(entry));
+            }
+            body += keys;
+
+            IndexHeader header{};
+            std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+            header.version = INDEX_VERSION;
+            header.endian = SNAPSHOT_ENDIAN;
+            header.source_size = source.size;
+            header.source_mtime = source.mtime;
+            header.entry_count = order.size();
+            header.key_column = static_cast<std::uint32_t>(key_column);
+            header.delimiter = delimiter;
+            header.trim = trim;
+            header.checksum = fnv1a(body);
+
+            std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+            bytes += body;
+            return bytes;
+        }
+    }
+
+    inline std::filesystem::path index_path(const std::filesystem::path& csv_file) {
+        auto path = csv_file;
+        path += ".idx";
+        return path;
+    }
+
+    // Index phụ ánh xạ giá trị một cột khóa (vd. mã sinh viên) sang byte offset
+    // các record trong file CSV. Tra cứu chỉ map file CSV và parse những row khớp.
+    // File CSV đổi kích thước hoặc mtime thì index tự dựng lại ở lần tra kế tiếp.
+    class CSVIndex {
+        std::filesystem::path _csv;
+        mio::mmap_source _map;
+        std::vector<char> _owned;
+
+        std::size_t _entries = 0;
+        const char* _table = nullptr;
+        const char* _keys = nullptr;
+        std::size_t _keys_size = 0;
+
+        Row _headers;
+        std::size_t _key_column = 0;
+        char _delimiter = ',';
+        bool _trim = true;
+        detail::FileStamp _source;
+
+        CSVIndex() = default;
+
+        // Kiểm tra header, cấu hình tách record, kích thước và checksum
+        bool attach(std::string_view bytes, std::size_t key_column, char delimiter, bool trim) {
+            using detail::IndexHeader;
+            using detail::IndexEntry;
+
+            if (bytes.size() < sizeof(IndexHeader))
+                return false;
+
+            IndexHeader header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+
+            if (std::memcmp(header.magic, detail::INDEX_MAGIC, sizeof(header.magic)) != 0
+                || header.version != detail::INDEX_VERSION
+                || header.endian != detail::SNAPSHOT_ENDIAN)
+                return false;
+
+            if (header.source_size != _source.size || header.source_mtime != _source.mtime
+                || header.key_column != key_column || header.delimiter != delimiter || header.trim != trim)
+                return false;
+
+            const std::uint64_t payload = bytes.size() - sizeof(IndexHeader);
+            if (header.entry_count > payload / sizeof(IndexEntry))
+                return false;
+
+            if (detail::fnv1a(bytes.substr(sizeof(IndexHeader))) != header.checksum)
+                return false;
+
+            _entries = header.entry_count;
+            _table = bytes.data() + sizeof(IndexHeader);
+            _keys = _table + _entries * sizeof(IndexEntry);
+            _keys_size = payload - _entries * sizeof(IndexEntry);
+            _key_column = key_column;
+            _delimiter = delimiter;
+            _trim = trim;
+            return true;
+        }
+
+        detail::IndexEntry entry(std::size_t i) const {
+            return detail::load<detail::IndexEntry>(_table + i * sizeof(detail::IndexEntry));
+        }
+
+        std::string_view key(const detail::IndexEntry& e) const {
+            if (e.key_offset > _keys_size || e.key_size > _keys_size - e.key_offset)
+                throw std::runtime_error("CSV index is corrupt: " + _csv.string());
+            return std::string_view(_keys + e.key_offset, e.key_size);
+        }
+
+        // [first, last) trong bảng có key bằng value
+        std::pair<std::size_t, std::size_t> range(std::string_view value) const {
+            std::size_t lo = 0, hi = _entries;
+            while (lo < hi) {
+                const std::size_t mid = lo + (hi - lo) / 2;
+                if (key(entry(mid)) < value)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            std::size_t last = lo;
+            while (last < _entries && key(entry(last)) == value)
+                ++last;
+            return { lo, last };
+        }
+
+        // File CSV đổi kích thước hoặc mtime kể từ khi dựng index thì dựng lại
+        void refresh() {
+            if (detail::stamp(_csv) != _source)
+                *this = load(_csv, key_column(), _delimiter, _trim);
+        }
+
+    public:
+        CSVIndex(CSVIndex&&) = default;
+        CSVIndex& operator=(CSVIndex&&) = default;
+
+        // Map file .idx cạnh csv_file; trả về nullopt nếu thiếu, cũ hơn file CSV,
+        // dựng theo cột khác hoặc hỏng
+        static std::optional<CSVIndex> open(
+            const std::filesystem::path& csv_file,
+            std::string_view key_column,
+            char delimiter = ',',
+            bool trim = true
+        ) {
+            const auto path = index_path(csv_file);
+
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(path, ec) || !std::filesystem::exists(csv_file, ec))
+                return std::nullopt;
+
+            CSVIndex index;
+            index._csv = csv_file;
+            index._source = detail::stamp(csv_file);
+            index._headers = detail::load_headers(csv_file, delimiter, trim);
+
+            index._map.map(path.string(), ec);
+            if (ec)
+                return std::nullopt;
+
+            const std::size_t column = ColumnIndex(index._headers, csv_file.string()).at(key_column);
+            if (!index.attach(std::string_view(index._map.data(), index._map.size()), column, delimiter, trim))
+                return std::nullopt;
+
+            return index;
+        }
+
+        // Dùng index nếu còn mới, không thì đọc CSV và ghi lại index cho lần sau
+        static CSVIndex load(
+            const std::filesystem::path& csv_file,
+            std::string_view key_column,
+            char delimiter = ',',
+            bool trim = true
+        ) {
+            if (auto index = open(csv_file, key_column, delimiter, trim))
+                return std::move(*index);
+
+            detail::check_file(csv_file);
+
+            CSVIndex index;
+            index._csv = csv_file;
+            index._source = detail::stamp(csv_file);
+
+            const CSVData data = read_csv(csv_file, delimiter, trim);
+            const std::size_t column = data.column_of(key_column);
+
+            std::vector<std::uint64_t> offsets;
+            {
+                mio::mmap_source source(csv_file.string());
+                offsets = detail::record_offsets(std::string_view(source.data(), source.size()), delimiter, trim);
+            }
+
+            const auto bytes = detail::serialize_index(data, column, offsets, delimiter, trim, index._source);
+            detail::write_atomic(index_path(csv_file), bytes);
+
+            index._headers = data.headers();
+            index._owned.assign(bytes.begin(), bytes.end());
+            index.attach(std::string_view(index._owned.data(), index._owned.size()), column, delimiter, trim);
+            return index;
+        }
+
+        const Row& headers() const {
+            return _headers;
+        }
+
+        const std::string& key_column() const {
+            return _headers[_key_column];
+        }
+
+        // Byte offset các record có key bằng value, theo thứ tự trong file
+        std::vector<std::uint64_t> offsets(std::string_view value) {
+            refresh();
+            const auto [first, last] = range(value);
+
+            std::vector<std::uint64_t> result;
+            result.reserve(last - first);
+            for (std::size_t i = first; i < last; ++i)
+                result.push_back(entry(i).record_offset);
+            return result;
+        }
+
+        bool contains(std::string_view value) {
+            refresh();
+            const auto [first, last] = range(value);
+            return first != last;
+        }
+
+        // Các row có key bằng value, theo thứ tự trong file. Nếu file CSV đã
+        // thay đổi kể từ khi dựng index thì dựng lại trước khi tra
+        Rows find(std::string_view value) {
+            refresh();
+
+            const auto [first, last] = range(value);
+            if (first == last)
+                return {};
+
+            mio::mmap_source source(_csv.string());
+            const std::string_view text(source.data(), source.size());
+
+            detail::ChunkResult result;
+            result.rows.reserve(last - first);
+            for (std::size_t i = first; i < last; ++i) {
+                const auto begin = entry(i).record_offset;
+                if (begin >= text.size())
+                    throw std::runtime_error("CSV index is corrupt: " + _csv.string());
+
+                const std::size_t end = detail::next_record(text, begin, _delimiter, _trim);
+                const std::size_t before = result.rows.size();
+                if (!detail::decode_record(text.substr(begin, end - begin), _headers, _delimiter, _trim, end == text.size(), result)
+                    || result.rows.size() != before + 1)
+                    throw std::runtime_error("CSV index is corrupt: " + _csv.string());
+            }
+            return std::move(result.rows);
+        }
+    };
+
+    namespace detail {
+        // Offset tính bằng đúng append_row mà write_csv dùng để ghi, không cần đọc lại file.
+        // Khớp từng byte vì validate_csv chặn row rỗng và append_row không bao giờ ghi ra
+        // dòng trống, nên reader không bỏ qua record nào
+        inline void write_index(const std::filesystem::path& csv_file, const CSVData& data, std::string_view key_column) {
+            const std::size_t column = data.column_of(key_column);
+
+            std::string scratch;
+            append_row(scratch, data.headers());
+            std::uint64_t pos = scratch.size();
+
+            std::vector<std::uint64_t> offsets;
+            offsets.reserve(data.rows.size());
+            for (const auto& row : data.rows) {
+                offsets.push_back(pos);
+                scratch.clear();
+                append_row(scratch, row);
+                pos += scratch.size();
+            }
+
+            write_atomic(index_path(csv_file), serialize_index(data, column, offsets, ',', true, stamp(csv_file)));
+        }
+    }
+
+    // Ghi index cho dữ liệu vừa đọc bằng read_csv, khỏi phải parse file lần nữa
+    inline void write_index(
+        const std::filesystem::path& csv_file,
+        const CSVData& data,
+        std::string_view key_column,
+        char delimiter = ',',
+        bool trim = true
+    ) {
+        mio::mmap_source source(csv_file.string());
+        const auto offsets = detail::record_offsets(std::string_view(source.data(), source.size()), delimiter, trim);
+        const std::size_t column = data.column_of(key_column);
+        detail::write_atomic(
+            index_path(csv_file),
+            detail::serialize_index(data, column, offsets, delimiter, trim, detail::stamp(csv_file))
+        );
+    }
+
+    namespace detail {
+        // Header cố định 64 byte ở đầu file bloom
+        struct BloomHeader {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t endian;
+            std::uint64_t source_size;
+            std::int64_t source_mtime;
+            std::uint64_t bit_count;
+            std::uint32_t hash_count;
+            std::uint32_t key_column;
+            std::uint64_t item_count;
+            std::uint64_t checksum; // FNV-1a của bit_count, hash_count rồi tới mảng bit
+        };
+        static_assert(sizeof(BloomHeader) == 64);
+
+        constexpr char BLOOM_MAGIC[8] = { 'D', 'D', 'B', 'L', 'O', 'O', 'M', 0 };
+        constexpr std::uint32_t BLOOM_VERSION = 2;
+        constexpr std::uint32_t BLOOM_MAX_HASHES = 30;
+
+        // Tham số quyết định vị trí bit cũng nằm trong checksum: sửa hash_count hay
+        // bit_count mà giữ nguyên mảng bit sẽ làm filter trả lời sai "không có"
+        inline std::uint64_t bloom_checksum(std::uint64_t bit_count, std::uint32_t hash_count, std::string_view bits) {
+            std::string params;
+            store(params, bit_count);
+            store(params, hash_count);
+            return fnv1a(bits, fnv1a(params));
+        }
+
+        inline std::uint64_t mix64(std::uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ull;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebull;
+            x ^= x >> 31;
+            return x;
+        }
+    }
+
+    inline std::filesystem::path bloom_path(const std::filesystem::path& csv_file) {
+        auto path = csv_file;
+        path += ".bloom";
+        return path;
+    }
+
+    // Bloom filter trên một cột khóa: might_contain() trả về false thì chắc chắn
+    // không có, true thì có thể có (sai với xác suất khoảng fp_rate).
+    // Vị trí bit thứ i là h1 + i * h2 (double hashing) nên mỗi lần tra chỉ băm một lần.
+    // Filter đọc từ file chỉ so với file CSV lúc open()/load()/refresh(), không phải mỗi
+    // lần tra: file CSV có thể đã bị ghi lại thì gọi refresh() trước một loạt lần tra.
+    class BloomFilter {
+        std::vector<std::uint64_t> _bits;
+        std::uint64_t _bit_count = 0;
+        std::uint32_t _hashes = 1;
+        std::uint64_t _items = 0;
+
+        // Filter đọc từ file .bloom nhớ nguồn để phát hiện file CSV bị ghi lại;
+        // _csv rỗng nghĩa là filter chỉ nằm trong bộ nhớ
+        std::filesystem::path _csv;
+        std::string _column_name;
+        double _fp_rate = 0.01;
+        char _delimiter = ',';
+        bool _trim = true;
+        std::uint32_t _key_column = 0;
+        detail::FileStamp _source;
+
+        template <typename Fn>
+        void probe(std::string_view key, Fn&& fn) const {
+            const std::uint64_t h1 = detail::mix64(detail::fnv1a(key));
+            const std::uint64_t h2 = detail::mix64(h1) | 1;
+            for (std::uint32_t i = 0; i < _hashes; ++i)
+                if (!fn((h1 + i * h2) % _bit_count))
+                    return;
+        }
+
+    public:
+        // m = -n ln p / (ln 2)^2 bit, k = (m / n) ln 2 hàm băm
+        explicit BloomFilter(std::size_t expected_items, double fp_rate = 0.01) {
+            if (!(fp_rate > 0.0 && fp_rate < 1.0))
+                throw std::runtime_error("Bloom filter false positive rate must be in (0, 1)");
+
+            const double ln2 = 0.6931471805599453;
+            const double n = static_cast<double>(std::max<std::size_t>(expected_items, 1));
+            const double bits = std::ceil(-n * std::log(fp_rate) / (ln2 * ln2));
+
+            _bit_count = std::max<std::uint64_t>(64, static_cast<std::uint64_t>(bits));
+            _hashes = static_cast<std::uint32_t>(std::clamp(std::round(bits / n * ln2), 1.0, static_cast<double>(detail::BLOOM_MAX_HASHES)));
+            _bits.assign((_bit_count + 63) / 64, 0);
+        }
+
+        void insert(std::string_view key) {
+            probe(key, [&](std::uint64_t bit) {
+                _bits[bit / 64] |= std::uint64_t{ 1 } << (bit % 64);
+                return true;
+            });
+            ++_items;
+        }
+
+        // Tra thẳng trên mảng bit, không kiểm tra file nguồn
+        bool might_contain(std::string_view key) const {
+            bool found = true;
+            probe(key, [&](std::uint64_t bit) {
+                found = (_bits[bit / 64] >> (bit % 64)) & 1;
+                return found;
+            });
+            return found;
+        }
+
+        bool stale() const {
+            return !_csv.empty() && detail::stamp(_csv) != _source;
+        }
+
+        // Filter của file CSV đã bị ghi lại thì dựng lại, vì filter cũ có thể trả lời sai "không có"
+        void refresh() {
+            if (stale())
+                *this = load(_csv, _column_name, _fp_rate, _delimiter, _trim);
+        }
+
+        std::size_t size() const {
+            return _items;
+        }
+
+        std::uint64_t bit_count() const {
+            return _bit_count;
+        }
+
+        std::uint32_t hash_count() const {
+            return _hashes;
+        }
+
+        std::string serialize(std::size_t key_column, const detail::FileStamp& source) const {
+            detail::BloomHeader header{};
+            std::memcpy(header.magic, detail::BLOOM_MAGIC, sizeof(header.magic));
+            header.version = detail::BLOOM_VERSION;
+            header.endian = detail::SNAPSHOT_ENDIAN;
+            header.source_size = source.size;
+            header.source_mtime = source.mtime;
+            header.bit_count = _bit_count;
+            header.hash_count = _hashes;
+            header.key_column = static_cast<std::uint32_t>(key_column);
+            header.item_count = _items;
+
+            const std::string_view bits(reinterpret_cast<const char*>(_bits.data()), _bits.size() * 8);
+            header.checksum = detail::bloom_checksum(_bit_count, _hashes, bits);
+
+            std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+            bytes += bits;
+            return bytes;
+        }
+
+        // Đọc file .bloom cạnh csv_file; trả về nullopt nếu thiếu, cũ hơn file CSV,
+        // dựng theo cột khác hoặc hỏng. Filter cũ có thể trả lời sai "không có"
+        // nên không bao giờ được dùng
+        static std::optional<BloomFilter> open(
+            const std::filesystem::path& csv_file,
+            std::string_view key_column,
+            char delimiter = ',',
+            bool trim = true
+        ) {
+            const auto path = bloom_path(csv_file);
+
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(path, ec) || !std::filesystem::exists(csv_file, ec))
+                return std::nullopt;
+
+            const auto source = detail::stamp(csv_file);
+            const std::size_t column = ColumnIndex(detail::load_headers(csv_file, delimiter, trim), csv_file.string()).at(key_column);
+
+            mio::mmap_source map;
+            map.map(path.string(), ec);
+            if (ec || map.size() < sizeof(detail::BloomHeader))
+                return std::nullopt;
+
+            detail::BloomHeader header;
+            std::memcpy(&header, map.data(), sizeof(header));
+
+            if (std::memcmp(header.magic, detail::BLOOM_MAGIC, sizeof(header.magic)) != 0
+                || header.version != detail::BLOOM_VERSION
+                || header.endian != detail::SNAPSHOT_ENDIAN
+                || header.source_size != source.size || header.source_mtime != source.mtime
+                || header.key_column != column
+                || header.hash_count == 0 || header.hash_count > detail::BLOOM_MAX_HASHES)
+                return std::nullopt;
+
+            // bit_count phải rơi vào đúng word cuối của payload
+            const std::string_view bits(map.data() + sizeof(header), map.size() - sizeof(header));
+            const std::uint64_t words = bits.size() / 8;
+            if (bits.size() % 8 != 0 || words == 0
+                || header.bit_count > words * 64 || header.bit_count <= (words - 1) * 64
+                || detail::bloom_checksum(header.bit_count, header.hash_count, bits) != header.checksum)
+                return std::nullopt;
+
+            BloomFilter filter(1);
+            filter._bits.resize(bits.size() / 8);
+            std::memcpy(filter._bits.data(), bits.data(), bits.size());
+            filter._bit_count = header.bit_count;
+            filter._hashes = header.hash_count;
+            filter._items = header.item_count;
+            filter._key_column = header.key_column;
+            filter._source = source;
+            filter._csv = csv_file;
+            filter._column_name = std::string(key_column);
+            filter._delimiter = delimiter;
+            filter._trim = trim;
+            // Tỉ lệ sai ước lượng lại từ m và n để lần dựng lại giữ kích thước tương đương
+            if (header.item_count > 0) {
+                const double ratio = static_cast<double>(header.bit_count) / static_cast<double>(header.item_count);
+                filter._fp_rate = std::clamp(std::exp(-ratio * 0.4804530139182014), 1e-9, 0.5);
+            }
+            return filter;
+        }
+
+        // Dùng filter nếu còn mới, không thì đọc cột khóa từ CSV và ghi lại filter cho lần sau
+        static BloomFilter load(
+            const std::filesystem::path& csv_file,
+            std::string_view key_column,
+            double fp_rate = 0.01,
+            char delimiter = ',',
+            bool trim = true
+        ) {
+            if (auto filter = open(csv_file, key_column, delimiter, trim))
+                return std::move(*filter);
+
+            detail::check_file(csv_file);
+            const auto source = detail::stamp(csv_file);
+            const auto data = read_csv(csv_file, Projection{ .names = { std::string(key_column) } }, delimiter, trim);
+            const std::size_t column = ColumnIndex(detail::load_headers(csv_file, delimiter, trim), csv_file.string()).at(key_column);
+
+            BloomFilter filter(data.rows.size(), fp_rate);
+            for (const auto& row : data.rows)
+                filter.insert(row[0]);
+            filter._key_column = static_cast<std::uint32_t>(column);
+            filter._source = source;
+            filter._csv = csv_file;
+            filter._column_name = std::string(key_column);
+            filter._fp_rate = fp_rate;
+            filter._delimiter = delimiter;
+            filter._trim = trim;
+
+            detail::write_atomic(bloom_path(csv_file), filter.serialize(column, source));
+            return filter;
+        }
+    };
+
+    namespace detail {
+        inline void write_bloom(const std::filesystem::path& csv_file, const CSVData& data, std::string_view key_column, double fp_rate) {
+            const std::size_t column = data.column_of(key_column);
+
+            BloomFilter filter(data.rows.size(), fp_rate);
+            for (const auto& row : data.rows)
+                filter.insert(column < row.size() ? std::string_view(row[column]) : std::string_view());
+
+            write_atomic(bloom_path(csv_file), filter.serialize(column, stamp(csv_file)));
+        }
+    }
+
+    // Cách viết của một file CSV: dấu phân cách, dòng header, có cần trim, có dùng quote
+    struct Dialect {
+        char delimiter = ',';
+        std::size_t header_row = 0;
+        bool trim = true;
+        bool quoted = false; // có field mở bằng quote trong phần đầu file
+
+        bool operator==(const Dialect&) const = default;
+    };
+
+    namespace detail {
+        constexpr std::size_t DIALECT_HEAD = 1 << 16;
+
+        // Có khoảng trắng sát dấu phân cách hoặc cuối dòng (ngoài quote) thì cần trim
+        inline void scan_dialect(std::string_view head, Dialect& dialect) {
+            bool in_quote = false;
+            bool field_start = true;
+            dialect.trim = false;
+            dialect.quoted = false;
+
+            for (std::size_t i = 0; i < head.size(); ++i) {
+                const char ch = head[i];
+
+                if (ch == '"') {
+                    if (field_start)
+                        dialect.quoted = true;
+                    in_quote = !in_quote;
+                    field_start = false;
+                    continue;
+                }
+                if (in_quote)
+                    continue;
+
+                if (ch == ' ' || ch == '\t') {
+                    if (field_start || i + 1 == head.size() || head[i + 1] == dialect.delimiter || is_newline(head[i + 1]))
+                        dialect.trim = true;
+                    continue; // khoảng trắng đầu field vẫn tính là đầu field
+                }
+
+                field_start = ch == dialect.delimiter || is_newline(ch);
+            }
+        }
+
+        // Danh tính của file: thiết bị + inode trên POSIX, đường dẫn tuyệt đối trên Windows
+        inline std::string file_identity(const std::filesystem::path& file) {
+#ifdef _WIN32
+            return std::filesystem::absolute(file).lexically_normal().string();
+#else
+            struct stat st;
+            if (::stat(file.c_str(), &st) != 0)
+                throw std::runtime_error("CSV file not found: " + file.string());
+            return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+#endif
+        }
+    }
+
+    // Đoán dialect từ phần đầu file: delimiter và dòng header theo csv::guess_format,
+    // trim và quote bằng một lượt quét phần đầu
+    inline Dialect detect_dialect(const std::filesystem::path& file) {
+        detail::check_file(file);
+
+        const auto guess = csv::guess_format(file.string());
+
+        Dialect dialect;
+        dialect.delimiter = guess.delim;
+        dialect.header_row = static_cast<std::size_t>(std::max(guess.header_row, 0));
+
+        mio::mmap_source source(file.string(), 0, std::min<std::size_t>(std::filesystem::file_size(file), detail::DIALECT_HEAD));
+        detail::scan_dialect(std::string_view(source.data(), source.size()), dialect);
+        return dialect;
+    }
+
+    // Cache dialect trên đĩa, khóa theo inode + mtime + kích thước của file CSV.
+    // Mỗi dòng của file cache: identity, size, mtime, delimiter, header_row, trim, quoted
+    // (cách nhau bằng tab). Giữ tối đa MAX_ENTRIES file, bỏ các mục cũ nhất.
+    class DialectCache {
+        struct Entry {
+            std::string identity;
+            detail::FileStamp stamp;
+            Dialect dialect;
+        };
+
+        std::filesystem::path _file;
+        std::vector<Entry> _entries;
+
+        static std::optional<Entry> parse_line(const std::string& line) {
+            std::istringstream in(line);
+            Entry entry;
+            int delimiter = 0, trim = 0, quoted = 0;
+
+            if (!std::getline(in, entry.identity, '\t')
+                || !(in >> entry.stamp.size >> entry.stamp.mtime >> delimiter >> entry.dialect.header_row >> trim >> quoted))
+                return std::nullopt;
+
+            entry.dialect.delimiter = static_cast<char>(delimiter);
+            entry.dialect.trim = trim != 0;
+            entry.dialect.quoted = quoted != 0;
+            return entry;
+        }
+
+        void save() const {
+            std::string out;
+            for (const auto& e : _entries)
+                out += e.identity + '\t' + std::to_string(e.stamp.size) + '\t' + std::to_string(e.stamp.mtime)
+                     + '\t' + std::to_string(static_cast<int>(e.dialect.delimiter))
+                     + '\t' + std::to_string(e.dialect.header_row)
+                     + '\t' + std::to_string(e.dialect.trim ? 1 : 0)
+                     + '\t' + std::to_string(e.dialect.quoted ? 1 : 0) + '\n';
+
+            // Thư mục cache tạo lần đầu chỉ chủ sở hữu được đọc ghi
+            const auto dir = _file.parent_path();
+            if (!dir.empty() && std::filesystem::create_directories(dir))
+                std::filesystem::permissions(dir, std::filesystem::perms::owner_all);
+
+            detail::write_atomic(_file, out);
+        }
+
+    public:
+        static constexpr std::size_t MAX_ENTRIES = 256;
+
+        // Thư mục cache riêng của người dùng ($XDG_CACHE_HOME, ~/.cache hoặc %LOCALAPPDATA%),
+        // không dùng thư mục tạm chung mà ai cũng ghi được
+        static std::filesystem::path default_path() {
+#ifdef _WIN32
+            if (const wchar_t* local = ::_wgetenv(L"LOCALAPPDATA"); local && *local)
+                return std::filesystem::path(local) / "diemdanh" / "dialects.cache";
+#else
+            if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg == '/')
+                return std::filesystem::path(xdg) / "diemdanh" / "dialects.cache";
+            if (const char* home = std::getenv("HOME"); home && *home)
+                return std::filesystem::path(home) / ".cache" / "diemdanh" / "dialects.cache";
+#endif
+            return "diemdanh_dialects.cache";
+        }
+
+        // File cache hỏng hoặc không đọc được thì coi như rỗng
+        explicit DialectCache(std::filesystem::path file = default_path()) : _file(std::move(file)) {
+            std::ifstream in(_file);
+            for (std::string line; std::getline(in, line);)
+                if (auto entry = parse_line(line))
+                    _entries.push_back(std::move(*entry));
+        }
+
+        // Dialect đã cache nếu file chưa đổi từ lần phát hiện trước
+        std::optional<Dialect> lookup(const std::filesystem::path& csv_file) const {
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(csv_file, ec))
+                return std::nullopt;
+
+            const auto identity = detail::file_identity(csv_file);
+            const auto current = detail::stamp(csv_file);
+            for (const auto& e : _entries)
+                if (e.identity == identity)
+                    return e.stamp == current ? std::optional<Dialect>(e.dialect) : std::nullopt;
+            return std::nullopt;
+        }
+
+        // Trúng cache thì không đọc file CSV; trượt thì phát hiện rồi ghi lại cache
+        Dialect detect(const std::filesystem::path& csv_file) {
+            if (auto dialect = lookup(csv_file))
+                return *dialect;
+
+            Entry entry{ detail::file_identity(csv_file), detail::stamp(csv_file), detect_dialect(csv_file) };
+
+            std::erase_if(_entries, [&](const Entry& e) { return e.identity == entry.identity; });
+            if (_entries.size() >= MAX_ENTRIES)
+                _entries.erase(_entries.begin(), _entries.begin() + (_entries.size() - MAX_ENTRIES + 1));
+            _entries.push_back(entry);
+
+            save();
+            return entry.dialect;
+        }
+
+        std::size_t size() const {
+            return _entries.size();
+        }
+    };
+
+    // Đọc theo dialect đã biết; số dòng trong lỗi tính từ dòng header
+    inline CSVData read_csv(const std::filesystem::path& file, const Dialect& dialect) {
+        detail::check_file(file);
+
+        auto format = detail::make_format(dialect.delimiter, dialect.trim);
+        format.header_row(static_cast<int>(dialect.header_row));
+        csv::CSVReader reader(file.string(), format);
+
+        CSVData data;
+        data.set_headers(detail::header_row(reader, file), file.string());
+
+        detail::visit_rows(reader, data.headers(), [&](const RowView& row) {
+            data.rows.push_back(row.to_row());
+        });
+
+        return data;
+    }
+
+    inline CSVData read_csv(const std::filesystem::path& file, DialectCache& cache) {
+        return read_csv(file, cache.detect(file));
+    }
+
+    enum class ReloadKind {
+        Appended, // chỉ parse phần nối thêm vào cuối file
+        Reloaded, // file bị ghi lại, đọc lại toàn bộ file đó
+        Removed,  // file biến mất, dữ liệu cũ được giữ nguyên
+        Failed    // đọc hoặc parse lỗi, dữ liệu cũ được giữ nguyên, lý do nằm trong error
+    };
+
+    struct FileChange {
+        std::filesystem::path file;
+        ReloadKind kind;
+        std::size_t rows_added = 0;
+        std::string error = {};
+    };
+
+    // Theo dõi các file CSV đã nạp và nạp lại khi chúng thay đổi: file chỉ được
+    // nối thêm thì parse phần đuôi mới, file bị ghi lại thì đọc lại riêng file đó.
+    // Trên Linux dùng inotify theo thư mục cha (để bắt cả kiểu ghi file tạm rồi
+    // rename của write_csv); nơi khác so kích thước / mtime mỗi lần poll().
+    class CSVWatcher {
+        struct Watched {
+            std::filesystem::path file;
+            char delimiter = ',';
+            bool trim = true;
+            CSVData data = {};
+
+            detail::FileStamp stamp = {};
+            std::string identity = {};
+            std::uint64_t consumed = 0;  // byte đã parse, luôn là ranh giới record
+            bool appendable = false;       // file kết thúc bằng xuống dòng
+            std::uint64_t prefix_hash = 0; // băm đầu và cuối phần đã parse, xem verify_hash()
+        };
+
+        static constexpr std::size_t VERIFY_WINDOW = 1 << 16;
+
+        // deque để tham chiếu data trả về từ watch() không bị vô hiệu khi theo dõi thêm file
+        std::deque<Watched> _files;
+
+#ifdef __linux__
+        int _inotify = -1;
+        std::vector<std::pair<int, std::filesystem::path>> _dirs; // watch descriptor -> thư mục
+#endif
+
+        static void throw_if_bad(const detail::ChunkResult& result, std::size_t column_count, std::size_t first_line) {
+            if (result.error)
+                std::rethrow_exception(result.error);
+            if (result.bad_row)
+                throw detail::integrity_error(first_line + result.bad_row, column_count, result.bad_size);
+        }
+
+        // Băm tối đa VERIFY_WINDOW byte đầu và VERIFY_WINDOW byte cuối phần đã parse, nên mỗi
+        // sự kiện tốn một lượng cố định thay vì tỉ lệ với kích thước file. Sửa giữ nguyên độ dài
+        // nằm hẳn giữa hai cửa sổ sẽ bị coi là chỉ nối thêm; ghi lại kiểu write_csv (file mới
+        // qua rename) hoặc làm file ngắn đi thì vẫn luôn bị đọc lại
+        static std::uint64_t verify_hash(std::string_view prefix) {
+            if (prefix.size() <= 2 * VERIFY_WINDOW)
+                return detail::fnv1a(prefix);
+            const auto head = detail::fnv1a(prefix.substr(0, VERIFY_WINDOW));
+            return detail::fnv1a(prefix.substr(prefix.size() - VERIFY_WINDOW), head);
+        }
+
+        // Đọc cả file từ một lần map, để dữ liệu và vị trí đã parse luôn khớp nhau.
+        // Stamp lấy trước khi map: file đổi trong lúc parse thì lần poll sau vẫn thấy khác
+        static void load(Watched& w) {
+            detail::check_file(w.file);
+
+            const auto stamp = detail::stamp(w.file);
+            auto identity = detail::file_identity(w.file);
+            mio::mmap_source source(w.file.string());
+            const std::string_view text(source.data(), source.size());
+
+            const std::size_t start = text.substr(0, 3) == "\xEF\xBB\xBF" ? 3 : 0;
+            const std::size_t header_end = detail::next_record(text, start, w.delimiter, w.trim);
+
+            CSVData data;
+            data.set_headers(detail::parse_headers(text.substr(start, header_end - start), w.delimiter, w.trim, w.file), w.file.string());
+
+            auto result = detail::parse_chunk(text, header_end, text.size(), data.headers(), w.delimiter, w.trim);
+            throw_if_bad(result, data.column_count(), 1);
+            data.rows = std::move(result.rows);
+
+            w.data = std::move(data);
+            w.stamp = stamp;
+            w.identity = std::move(identity);
+            w.consumed = text.size();
+            w.appendable = detail::is_newline(text.back());
+            w.prefix_hash = verify_hash(text);
+        }
+
+        // Parse phần nối thêm nếu file vẫn là file cũ (cùng inode) và phần đã parse
+        // không đổi; chỉ nhận các record đã kết thúc bằng xuống dòng
+        static std::optional<std::size_t> append_tail(Watched& w) {
+            if (!w.appendable || detail::file_identity(w.file) != w.identity)
+                return std::nullopt;
+
+            const auto stamp = detail::stamp(w.file);
+            mio::mmap_source source(w.file.string());
+            const std::string_view text(source.data(), source.size());
+            if (text.size() < w.consumed || verify_hash(text.substr(0, w.consumed)) != w.prefix_hash)
+                return std::nullopt;
+
+            std::size_t end = w.consumed;
+            for (std::size_t pos = w.consumed; pos < text.size();) {
+                pos = detail::next_record(text, pos, w.delimiter, w.trim);
+                if (detail::is_newline(text[pos - 1]))
+                    end = pos;
+            }
+
+            const auto complete = text.substr(0, end);
+            auto result = detail::parse_chunk(complete, w.consumed, end, w.data.headers(), w.delimiter, w.trim);
+            throw_if_bad(result, w.data.column_count(), w.data.rows.size() + 1);
+
+            const std::size_t added = result.rows.size();
+            std::move(result.rows.begin(), result.rows.end(), std::back_inserter(w.data.rows));
+
+            w.stamp = stamp;
+            w.prefix_hash = verify_hash(complete);
+            w.consumed = end;
+            return added;
+        }
+
+        static std::optional<FileChange> refresh(Watched& w) {
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(w.file, ec)) {
+                if (w.identity.empty())
+                    return std::nullopt;
+                w.identity.clear();
+                return FileChange{ w.file, ReloadKind::Removed, 0 };
+            }
+
+            if (!w.identity.empty() && detail::stamp(w.file) == w.stamp && detail::file_identity(w.file) == w.identity)
+                return std::nullopt;
+
+            if (!w.identity.empty()) {
+                if (auto added = append_tail(w))
+                    return FileChange{ w.file, ReloadKind::Appended, *added };
+            }
+
+            const std::size_t before = w.data.rows.size();
+            load(w);
+            return FileChange{ w.file, ReloadKind::Reloaded, w.data.rows.size() > before ? w.data.rows.size() - before : 0 };
+        }
+
+        // Lỗi của một file không được làm mất thay đổi của các file khác trong cùng lần poll.
+        // Ghi nhận stamp hiện tại để file lỗi không bị báo lại cho tới khi nó đổi tiếp
+        static std::optional<FileChange> try_refresh(Watched& w) {
+            try {
+                return refresh(w);
+            }
+            catch (const std::exception& e) {
+                std::error_code ec;
+                if (std::filesystem::is_regular_file(w.file, ec)) {
+                    try {
+                        w.stamp = detail::stamp(w.file);
+                        w.identity = detail::file_identity(w.file);
+                    }
+                    catch (const std::exception&) {
+                    }
+                }
+                return FileChange{ w.file, ReloadKind::Failed, 0, e.what() };
+            }
+        }
+
+#ifdef __linux__
+        void watch_directory(const std::filesystem::path& dir) {
+            for (const auto& [wd, path] : _dirs)
+                if (path == dir)
+                    return;
+
+            const int wd = ::inotify_add_watch(_inotify, dir.c_str(),
+                IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+            if (wd < 0)
+                throw std::runtime_error("Failed to watch directory: " + dir.string());
+            _dirs.emplace_back(wd, dir);
+        }
+
+        // Đợi sự kiện tới timeout rồi trả về những file được nhắc tới; nullopt là
+        // hàng đợi inotify bị tràn, phải kiểm tra mọi file
+        std::optional<std::vector<std::filesystem::path>> read_events(int timeout_ms) {
+            std::vector<std::filesystem::path> touched;
+
+            pollfd pfd{ _inotify, POLLIN, 0 };
+            if (::poll(&pfd, 1, timeout_ms) <= 0)
+                return touched;
+
+            alignas(inotify_event) char buffer[1 << 14];
+            for (;;) {
+                const ssize_t n = ::read(_inotify, buffer, sizeof(buffer));
+                if (n <= 0)
+                    break;
+
+                for (const char* p = buffer; p < buffer + n;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(p);
+                    p += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW)
+                        return std::nullopt;
+
+                    for (const auto& [wd, dir] : _dirs)
+                        if (wd == event->wd && event->len > 0)
+                            touched.push_back(dir / event->name);
+                }
+            }
+
+            return touched;
+        }
+#endif
+
+    public:
+        CSVWatcher() {
+#ifdef __linux__
+            _inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (_inotify < 0)
+                throw std::runtime_error("Failed to initialize inotify");
+#endif
+        }
+
+        CSVWatcher(const CSVWatcher&) = delete;
+        CSVWatcher& operator=(const CSVWatcher&) = delete;
+
+        ~CSVWatcher() {
+#ifdef __linux__
+            ::close(_inotify);
+#endif
+        }
+
+        // Nạp file và bắt đầu theo dõi; gọi lại với file đã theo dõi thì không làm gì
+        const CSVData& watch(const std::filesystem::path& file, char delimiter = ',', bool trim = true) {
+            const auto path = std::filesystem::absolute(file).lexically_normal();
+            for (const auto& w : _files)
+                if (w.file == path)
+                    return w.data;
+
+            Watched w{ .file = path, .delimiter = delimiter, .trim = trim };
+            load(w);
+#ifdef __linux__
+            watch_directory(path.parent_path());
+#endif
+            _files.push_back(std::move(w));
+            return _files.back().data;
+        }
+
+        const CSVData& data(const std::filesystem::path& file) const {
+            const auto path = std::filesystem::absolute(file).lexically_normal();
+            for (const auto& w : _files)
+                if (w.file == path)
+                    return w.data;
+            throw std::runtime_error("CSV file is not watched: " + file.string());
+        }
+
+        // Chờ tối đa timeout để có thay đổi rồi áp dụng chúng; trả về các file đã
+        // thay đổi. File đọc lỗi giữ nguyên dữ liệu cũ và được báo bằng ReloadKind::Failed,
+        // các file khác vẫn được xử lý bình thường
+        std::vector<FileChange> poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+            std::vector<FileChange> changes;
+
+#ifdef __linux__
+            const auto touched = read_events(static_cast<int>(timeout.count()));
+            for (auto& w : _files) {
+                const bool hit = !touched || std::find(touched->begin(), touched->end(), w.file) != touched->end();
+                if (hit)
+                    if (auto change = try_refresh(w))
+                        changes.push_back(std::move(*change));
+            }
+#else
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            for (;;) {
+                for (auto& w : _files)
+                    if (auto change = try_refresh(w))
+                        changes.push_back(std::move(*change));
+
+                if (!changes.empty() || std::chrono::steady_clock::now() >= deadline)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+#endif
+
+            return changes;
+        }
+
+        std::size_t size() const {
+            return _files.size();
+        }
+    };
+
+    namespace detail {
+        // Chờ bận ngắn: quay vài vòng rồi nhường CPU. pause() trả về false khi đã chờ
+        // đủ lâu, lúc đó người gọi nên ngủ hẳn trên Parker thay vì tiếp tục quay
+        class Backoff {
+            unsigned _count = 0;
+
+        public:
+            bool pause() {
+                if (++_count < 64)
+                    return true;
+                if (_count < 128) {
+                    std::this_thread::yield();
+                    return true;
+                }
+                return false;
+            }
+
+            void reset() {
+                _count = 0;
+            }
+        };
+
+        // Chỗ ngủ cho luồng rảnh (kiểu eventcount): đọc epoch() trước khi kiểm tra
+        // điều kiện, điều kiện chưa thỏa thì wait(epoch đã đọc). notify() tăng epoch nên
+        // không mất lần đánh thức nào, và chỉ khóa mutex khi thật sự có luồng đang ngủ
+        class Parker {
+            std::mutex _mutex;
+            std::condition_variable _cv;
+            std::atomic<std::uint64_t> _epoch{ 0 };
+            std::atomic<std::uint32_t> _waiters{ 0 };
+
+        public:
+            std::uint64_t epoch() const {
+                return _epoch.load();
+            }
+
+            void wait(std::uint64_t seen) {
+                std::unique_lock lock(_mutex);
+                _waiters.fetch_add(1);
+                _cv.wait(lock, [&] { return _epoch.load() != seen; });
+                _waiters.fetch_sub(1);
+            }
+
+            void notify() {
+                _epoch.fetch_add(1);
+                if (_waiters.load() != 0) {
+                    std::lock_guard lock(_mutex);
+                    _cv.notify_all();
+                }
+            }
+        };
+
+        // Hàng đợi MPMC có giới hạn, không khóa (thuật toán của Vyukov): mỗi ô có
+        // số thứ tự cho biết ô đang trống hay đã có dữ liệu cho vòng hiện tại.
+        // push()/pop() quay một lúc rồi ngủ trên Parker tới khi phía bên kia có động tĩnh
+        template <typename T>
+        class BoundedQueue {
+            struct Cell {
+                std::atomic<std::size_t> seq;
+                T value;
+            };
+
+            std::unique_ptr<Cell[]> _cells;
+            std::size_t _mask;
+            alignas(64) std::atomic<std::size_t> _head{ 0 };
+            alignas(64) std::atomic<std::size_t> _tail{ 0 };
+
+            Parker _readable; // báo khi có phần tử mới
+            Parker _writable; // báo khi có ô trống
+
+        public:
+            explicit BoundedQueue(std::size_t capacity)
+                : _cells(new Cell[std::bit_ceil(std::max<std::size_t>(capacity, 2))]),
+                  _mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1) {
+                for (std::size_t i = 0; i <= _mask; ++i)
+                    _cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+
+            // Chỉ move value đi khi đẩy được
+            bool try_push(T& value) {
+                std::size_t pos = _tail.load(std::memory_order_relaxed);
+                for (;;) {
+                    Cell& cell = _cells[pos & _mask];
+                    const std::size_t seq = cell.seq.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+                    if (diff == 0) {
+                        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            cell.value = std::move(value);
+                            cell.seq.store(pos + 1, std::memory_order_release);
+                            _readable.notify();
+                            return true;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false; // đầy
+                    }
+                    else {
+                        pos = _tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool try_pop(T& out) {
+                std::size_t pos = _head.load(std::memory_order_relaxed);
+                for (;;) {
+                    Cell& cell = _cells[pos & _mask];
+                    const std::size_t seq = cell.seq.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+                    if (diff == 0) {
+                        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            out = std::move(cell.value);
+                            cell.seq.store(pos + _mask + 1, std::memory_order_release);
+                            _writable.notify();
+                            return true;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false; // rỗng
+                    }
+                    else {
+                        pos = _head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // Chờ tới khi đẩy được; trả về false nếu stop() thành true trước đó.
+            // Ai làm stop() đổi giá trị phải gọi wake()
+            template <typename Stop>
+            bool push(T& value, Stop&& stop) {
+                Backoff backoff;
+                for (;;) {
+                    const auto seen = _writable.epoch();
+                    if (try_push(value))
+                        return true;
+                    if (stop())
+                        return false;
+                    if (!backoff.pause())
+                        _writable.wait(seen);
+                }
+            }
+
+            template <typename Stop>
+            bool pop(T& out, Stop&& stop) {
+                Backoff backoff;
+                for (;;) {
+                    const auto seen = _readable.epoch();
+                    if (try_pop(out))
+                        return true;
+                    if (stop())
+                        return false;
+                    if (!backoff.pause())
+                        _readable.wait(seen);
+                }
+            }
+
+            void wake() {
+                _readable.notify();
+                _writable.notify();
+            }
+        };
+
+        struct Batch {
+            std::size_t seq = 0;
+            Rows rows;
+        };
+
+        constexpr std::size_t END_OF_STREAM = std::numeric_limits<std::size_t>::max();
+    }
+
+    struct TransformOptions {
+        std::size_t threads = 0;      // số worker biến đổi, 0 là dùng toàn bộ core
+        std::size_t queue_depth = 16; // số batch tối đa đang nằm trong pipeline
+        std::size_t batch_rows = 4096;
+        char delimiter = ',';         // của file đầu vào; file đầu ra theo định dạng write_csv
+        bool trim = true;
+        Row headers = {};             // header đầu ra, rỗng là giữ nguyên header đầu vào
+    };
+
+    // Biến đổi file CSV theo kiểu streaming: một luồng đọc gom row thành batch,
+    // các worker gọi fn trên từng row, một luồng ghi xếp batch lại đúng thứ tự và
+    // ghi ra file tạm rồi rename như write_csv. Các stage nối bằng hàng đợi không
+    // khóa có giới hạn, stage rảnh thì ngủ trên condition variable chứ không quay;
+    // luồng đọc dừng lại khi đã có queue_depth batch chưa ghi,
+    // nên bộ nhớ tối đa tỉ lệ với queue_depth * batch_rows chứ không với kích thước file.
+    // fn nhận Row& (được gọi đồng thời từ nhiều worker), trả về void hoặc bool
+    // (false để bỏ row). Trả về số row đã ghi.
+    template <typename Fn>
+    std::size_t transform_csv(
+        const std::filesystem::path& input,
+        const std::filesystem::path& output,
+        Fn&& fn,
+        const TransformOptions& options = {}
+    ) {
+        detail::check_file(input);
+
+        const std::size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        const std::size_t depth = std::max<std::size_t>(options.queue_depth, 2);
+        const std::size_t batch_rows = std::max<std::size_t>(options.batch_rows, 1);
+
+        csv::CSVReader reader(input.string(), detail::make_format(options.delimiter, options.trim));
+        const Row in_headers = detail::read_headers(reader, input);
+        const Row& out_headers = options.headers.empty() ? in_headers : options.headers;
+
+        detail::BoundedQueue<detail::Batch> todo(depth);
+        detail::BoundedQueue<detail::Batch> done(depth);
+
+        std::atomic<std::size_t> total{ detail::END_OF_STREAM }; // số batch, biết khi đọc xong
+        std::atomic<std::size_t> written{ 0 };                  // số batch đã ghi
+        detail::Parker progress;                                // báo khi written tăng
+        std::size_t rows_written = 0;
+
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        auto fail = [&](std::exception_ptr e) {
+            if (!failed.exchange(true))
+                error = e;
+            todo.wake();
+            done.wake();
+            progress.notify();
+        };
+        auto stopped = [&] {
+            return failed.load(std::memory_order_relaxed);
+        };
+
+        auto worker = [&] {
+            detail::Batch batch;
+
+            while (todo.pop(batch, stopped)) {
+                if (batch.seq == detail::END_OF_STREAM)
+                    return;
+
+                try {
+                    std::size_t kept = 0;
+                    for (auto& row : batch.rows) {
+                        if constexpr (std::is_same_v<std::invoke_result_t<Fn&, Row&>, bool>) {
+                            if (!fn(row))
+                                continue;
+                        }
+                        else {
+                            fn(row);
+                        }
+
+                        if (row.size() != out_headers.size())
+                            throw std::runtime_error("Transform produced a row with " + std::to_string(row.size())
+                                                     + " columns, expected " + std::to_string(out_headers.size()));
+
+                        if (&batch.rows[kept] != &row)
+                            batch.rows[kept] = std::move(row);
+                        ++kept;
+                    }
+                    batch.rows.resize(kept);
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                    return;
+                }
+
+                if (!done.push(batch, stopped))
+                    return;
+            }
+        };
+
+        std::filesystem::path tmp;
+        auto out = detail::create_temp(output, tmp);
+
+        auto writer = [&] {
+            try {
+                std::string buffer;
+                buffer.reserve(detail::WRITE_BUFFER + (1 << 12));
+                detail::append_row(buffer, out_headers);
+
+                // Batch tới sớm chờ ở đây; nhờ giới hạn depth nên seq % depth không trùng
+                std::vector<std::optional<Rows>> pending(depth);
+                std::size_t next = 0;
+                detail::Batch batch;
+
+                while (next != total.load()) {
+                    if (!done.pop(batch, [&] { return stopped() || next == total.load(); }))
+                        break;
+
+                    pending[batch.seq % depth] = std::move(batch.rows);
+                    while (pending[next % depth]) {
+                        for (const auto& row : *pending[next % depth]) {
+                            detail::append_row(buffer, row);
+                            if (buffer.size() >= detail::WRITE_BUFFER) {
+                                out.write(buffer);
+                                buffer.clear();
+                            }
+                        }
+
+                        rows_written += pending[next % depth]->size();
+                        pending[next % depth].reset();
+                        written.store(++next);
+                        progress.notify();
+                    }
+                }
+
+                if (failed)
+                    return;
+
+                out.write(buffer);
+                out.sync();
+                out.close();
+            }
+            catch (...) {
+                fail(std::current_exception());
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (std::size_t t = 0; t < threads; ++t)
+            pool.emplace_back(worker);
+        std::thread writer_thread(writer);
+
+        // Stage đọc chạy trên luồng gọi
+        std::size_t seq = 0;
+        auto submit = [&](detail::Batch& batch) {
+            for (;;) {
+                const auto seen = progress.epoch();
+                if (stopped() || seq - written.load() < depth)
+                    break;
+                progress.wait(seen);
+            }
+
+            batch.seq = seq++;
+            todo.push(batch, stopped);
+            batch.rows.clear();
+            batch.rows.reserve(batch_rows);
+        };
+
+        try {
+            detail::Batch batch;
+            batch.rows.reserve(batch_rows);
+
+            detail::visit_rows(reader, in_headers, [&](const RowView& row) {
+                if (failed.load(std::memory_order_relaxed))
+                    return false;
+
+                batch.rows.push_back(row.to_row());
+                if (batch.rows.size() == batch_rows)
+                    submit(batch);
+                return true;
+            });
+
+            if (!batch.rows.empty())
+                submit(batch);
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+
+        total.store(seq);
+        done.wake(); // luồng ghi có thể đang chờ mà đã ghi đủ
+        for (std::size_t t = 0; t < threads; ++t) {
+            detail::Batch stop{ detail::END_OF_STREAM, {} };
+            todo.push(stop, stopped);
+        }
+
+        for (auto& t : pool)
+            t.join();
+        writer_thread.join();
+
+        if (failed) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            std::rethrow_exception(error);
+        }
+
+        try {
+            std::filesystem::rename(tmp, output);
+        }
+        catch (...) {
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            throw;
+        }
+        detail::sync_directory(output);
+
+        return rows_written;
+    }
+
+    struct SortOptions {
+        std::vector<std::string> keys = {};     // cột khóa theo thứ tự ưu tiên, so sánh theo byte
+        std::size_t memory_budget = 256u << 20; // byte cho toàn bộ các run đang nằm trong bộ nhớ
+        std::size_t threads = 0;                // số luồng sắp xếp run, 0 là dùng toàn bộ core
+        char delimiter = ',';                   // của file đầu vào; file đầu ra theo định dạng write_csv
+        bool trim = true;
+        std::filesystem::path temp_dir = {};    // nơi chứa run tạm, rỗng là thư mục tạm của hệ thống
+    };
+
+    namespace detail {
+        inline std::size_t row_bytes(const Row& row) {
+            std::size_t bytes = sizeof(Row);
+            for (const auto& cell : row)
+                bytes += sizeof(Cell) + (cell.size() > 15 ? cell.capacity() : 0);
+            return bytes;
+        }
+
+        // Run tạm: mỗi cell là độ dài uint32 rồi tới các byte, không cần parse khi đọc lại
+        inline void write_run(const std::filesystem::path& file, const Rows& rows) {
+            File out(file, OpenMode::Create);
+            std::string buffer;
+            buffer.reserve(WRITE_BUFFER + (1 << 12));
+
+            for (const auto& row : rows) {
+                for (const auto& cell : row) {
+                    store(buffer, static_cast<std::uint32_t>(cell.size()));
+                    buffer += cell;
+                }
+                if (buffer.size() >= WRITE_BUFFER) {
+                    out.write(buffer);
+                    buffer.clear();
+                }
+            }
+
+            out.write(buffer);
+        }
+
+        class RunReader {
+            std::vector<char> _buffer;
+            std::ifstream _in;
+            std::size_t _columns;
+            std::filesystem::path _file;
+
+        public:
+            RunReader(const std::filesystem::path& file, std::size_t columns)
+                : _buffer(1 << 16), _columns(columns), _file(file) {
+                _in.rdbuf()->pubsetbuf(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+                _in.open(file, std::ios::binary);
+                if (!_in)
+                    throw std::runtime_error("Failed to open file: " + file.string());
+            }
+
+            // false khi hết run
+            bool next(Row& row) {
+                row.resize(_columns);
+                for (std::size_t c = 0; c < _columns; ++c) {
+                    std::uint32_t size;
+                    if (!_in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+                        if (c == 0 && _in.eof())
+                            return false;
+                        throw std::runtime_error("Sort run is corrupt: " + _file.string());
+                    }
+
+                    row[c].resize(size);
+                    if (!_in.read(row[c].data(), size))
+                        throw std::runtime_error("Sort run is corrupt: " + _file.string());
+                }
+                return true;
+            }
+        };
+
+        // Cây loser cho k-way merge: nút trong giữ bên thua của trận đấu tại đó,
+        // _tree[0] là bên thắng chung cuộc. Sau khi lá thắng đổi giá trị chỉ cần
+        // đấu lại dọc một đường từ lá lên gốc, log2(k) lần so sánh.
+        // Lá i nằm ở vị trí k + i, cha của nút n là n / 2.
+        template <typename Less>
+        class LoserTree {
+            std::size_t _k;
+            std::vector<std::size_t> _tree;
+            Less _less;
+
+        public:
+            LoserTree(std::size_t k, Less less) : _k(k), _tree(std::max<std::size_t>(k, 1)), _less(std::move(less)) {
+                std::vector<std::size_t> winner(2 * _k);
+                for (std::size_t i = 0; i < _k; ++i)
+                    winner[_k + i] = i;
+
+                for (std::size_t n = _k - 1; n > 0; --n) {
+                    std::size_t a = winner[2 * n], b = winner[2 * n + 1];
+                    if (_less(b, a))
+                        std::swap(a, b);
+                    winner[n] = a;
+                    _tree[n] = b;
+                }
+                _tree[0] = _k > 1 ? winner[1] : 0;
+            }
+
+            std::size_t top() const {
+                return _tree[0];
+            }
+
+            void replay() {
+                std::size_t w = _tree[0];
+                for (std::size_t n = (_k + w) / 2; n > 0; n /= 2)
+                    if (_less(_tree[n], w))
+                        std::swap(_tree[n], w);
+                _tree[0] = w;
+            }
+        };
+
+        inline bool less_by_keys(const Row& a, const Row& b, const std::vector<std::size_t>& keys) {
+            for (auto k : keys) {
+                const int c = a[k].compare(b[k]);
+                if (c != 0)
+                    return c < 0;
+            }
+            return false;
+        }
+
+        // Xóa các run tạm khi ra khỏi phạm vi, kể cả khi có lỗi
+        struct RunFiles {
+            std::vector<std::filesystem::path> paths;
+
+            ~RunFiles() {
+                std::error_code ec;
+                for (const auto& path : paths)
+                    std::filesystem::remove(path, ec);
+            }
+        };
+    }
+
+    // Sắp xếp file CSV lớn hơn bộ nhớ theo các cột khóa (ổn định: row có khóa
+    // bằng nhau giữ thứ tự trong file). Row được gom thành các run vừa với
+    // memory_budget, mỗi run được sắp xếp và ghi ra file tạm trên một luồng riêng
+    // trong khi luồng gọi tiếp tục đọc; sau đó trộn k run một lượt bằng cây loser
+    // và ghi ra output theo định dạng write_csv (file tạm rồi rename).
+    // Nếu cả file vừa một run thì sắp xếp trong bộ nhớ, không ghi run tạm.
+    // Trả về số row đã ghi.
+    inline std::size_t sort_csv(
+        const std::filesystem::path& input,
+        const std::filesystem::path& output,
+        const SortOptions& options
+    ) {
+        detail::check_file(input);
+        if (options.keys.empty())
+            throw std::runtime_error("sort_csv needs at least one key column");
+
+        const std::size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        // Một run đang được đọc cộng tối đa threads run đang được sắp xếp
+        const std::size_t run_budget = std::max<std::size_t>(options.memory_budget / (threads + 1), 1 << 16);
+        const auto temp_dir = options.temp_dir.empty() ? std::filesystem::temp_directory_path() : options.temp_dir;
+
+        csv::CSVReader reader(input.string(), detail::make_format(options.delimiter, options.trim));
+        const Row headers = detail::header_row(reader, input);
+        const ColumnIndex columns(headers, input.string());
+
+        std::vector<std::size_t> keys;
+        for (const auto& key : options.keys)
+            keys.push_back(columns.at(key));
+
+        auto less = [&](const Row& a, const Row& b) {
+            return detail::less_by_keys(a, b, keys);
+        };
+
+        // Tên run tạm riêng cho lần gọi này
+        const std::string prefix = "diemdanh_sort_" + std::to_string(std::random_device{}()) + "_"
+                                   + std::to_string(reinterpret_cast<std::uintptr_t>(&reader)) + "_";
+
+        detail::RunFiles runs;
+        std::vector<std::thread> active;
+        std::deque<std::exception_ptr> errors; // deque để con trỏ tới phần tử không đổi khi thêm
+        std::size_t spilled = 0;
+
+        auto spill = [&](Rows rows) {
+            if (active.size() == threads) {
+                active.front().join();
+                active.erase(active.begin());
+            }
+
+            runs.paths.push_back(temp_dir / (prefix + std::to_string(spilled++) + ".run"));
+            auto* error = &errors.emplace_back();
+
+            active.emplace_back([&less, error, rows = std::move(rows), path = runs.paths.back()]() mutable {
+                try {
+                    std::stable_sort(rows.begin(), rows.end(), less);
+                    detail::write_run(path, rows);
+                }
+                catch (...) {
+                    *error = std::current_exception();
+                }
+            });
+        };
+
+        auto join_all = [&] {
+            for (auto& t : active)
+                t.join();
+            active.clear();
+        };
+
+        Rows current;
+        std::size_t current_bytes = 0;
+        std::size_t row_count = 0;
+
+        try {
+            detail::visit_rows(reader, headers, [&](const RowView& view) {
+                Row row = view.to_row();
+                current_bytes += detail::row_bytes(row);
+                current.push_back(std::move(row));
+                ++row_count;
+
+                if (current_bytes >= run_budget) {
+                    spill(std::move(current));
+                    current = {};
+                    current_bytes = 0;
+                }
+            });
+        }
+        catch (...) {
+            join_all();
+            throw;
+        }
+        join_all();
+
+        for (const auto& error : errors)
+            if (error)
+                std::rethrow_exception(error);
+
+        std::filesystem::path tmp;
+        auto out = detail::create_temp(output, tmp);
+        try {
+            std::string buffer;
+            buffer.reserve(detail::WRITE_BUFFER + (1 << 12));
+            detail::append_row(buffer, headers);
+
+            auto emit = [&](const Row& row) {
+                detail::append_row(buffer, row);
+                if (buffer.size() >= detail::WRITE_BUFFER) {
+                    out.write(buffer);
+                    buffer.clear();
+                }
+            };
+
+            if (spilled == 0) {
+                std::stable_sort(current.begin(), current.end(), less);
+                for (const auto& row : current)
+                    emit(row);
+            }
+            else {
+                // Phần còn lại trong bộ nhớ là run cuối cùng
+                if (!current.empty()) {
+                    std::stable_sort(current.begin(), current.end(), less);
+                    runs.paths.push_back(temp_dir / (prefix + std::to_string(spilled) + ".run"));
+                    detail::write_run(runs.paths.back(), current);
+                    Rows().swap(current);
+                }
+
+                const std::size_t k = runs.paths.size();
+                std::vector<std::unique_ptr<detail::RunReader>> readers;
+                std::vector<Row> heads(k);
+                std::vector<bool> live(k);
+                for (std::size_t i = 0; i < k; ++i) {
+                    readers.push_back(std::make_unique<detail::RunReader>(runs.paths[i], headers.size()));
+                    live[i] = readers[i]->next(heads[i]);
+                }
+
+                // Run hết được coi là lớn nhất; khóa bằng nhau thì run trước thắng để giữ ổn định
+                detail::LoserTree tree(k, [&](std::size_t a, std::size_t b) {
+                    if (!live[a] || !live[b])
+                        return live[a] && !live[b];
+                    if (less(heads[a], heads[b]))
+                        return true;
+                    if (less(heads[b], heads[a]))
+                        return false;
+                    return a < b;
+                });
+
+                for (std::size_t top = tree.top(); live[top]; top = tree.top()) {
+                    emit(heads[top]);
+                    live[top] = readers[top]->next(heads[top]);
+                    tree.replay();
+                }
+            }
+
+            out.write(buffer);
+            out.sync();
+            out.close();
+            std::filesystem::rename(tmp, output);
+        }
+        catch (...) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            throw;
+        }
 
-        auto writer = csv::make_csv_writer(ofs);
-        writer << data.headers;
-        for (const auto& row : data.rows) 
-            writer << row;
+        detail::sync_directory(output);
+        return row_count;
     }
 }
 
@@ -193,7 +4203,7 @@ namespace utility_input {
     }
 
     template <>
-    bool parse<std::string>(const std::string& input, std::string& out) {
+    inline bool parse<std::string>(const std::string& input, std::string& out) {
         if (input.empty()) return false;
         out = input;
         return true;
@@ -1,7 +1,47 @@
 #include <iostream>
+#include <string_view>
+#include <charconv>
+#include <exception>
 #include "models.hpp"
 
-int main() {
+// diemdanh --calibrate-hash [target_ms]: đo thời gian băm trên máy này rồi
+// lưu ops/mem cho các mật khẩu mới vào HashProfile::defaultPath()
+static int calibrateHashCommand(int argc, char** argv) {
+    int target_ms = 250;
+    if (argc > 2) {
+        // Phải là số nguyên dương, không nhận phần thừa kiểu "250ms" hay "1e3"
+        const std::string_view arg(argv[2]);
+        auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), target_ms);
+        if (ec != std::errc{} || ptr != arg.data() + arg.size() || target_ms <= 0) {
+            std::cerr << "Invalid target latency: " << argv[2] << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Calibrating password hashing for " << target_ms << " ms...\n";
+    auto result = calibrateHash(std::chrono::milliseconds(target_ms));
+
+    std::cout << "opslimit: " << result.profile.opslimit << "\n"
+              << "memlimit: " << result.profile.memlimit / (1024 * 1024) << " MiB\n"
+              << "latency:  " << result.latency.count() << " ms\n";
+
+    const auto path = HashProfile::defaultPath();
+    try {
+        result.profile.save(path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to save hash profile to " << path.string() << ": " << e.what() << "\n";
+        return 1;
+    }
+
+    std::cout << "Saved to " << path.string() << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string_view(argv[1]) == "--calibrate-hash")
+        return calibrateHashCommand(argc, argv);
+
     DateTime now = DateTime::now();
     std::cout << "Now: " << now.toString() << "\n";
 
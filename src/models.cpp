@@ -1,15 +1,190 @@
 #include "models.hpp"
+#include "utility.hpp"
+
+#include <charconv>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <exception>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// ================ HashProfile ================
+namespace {
+    std::mutex profile_mutex;
+    std::optional<HashProfile> profile_current;
+
+    bool inLimits(const HashProfile& profile) {
+        return profile.opslimit >= crypto_pwhash_OPSLIMIT_MIN && profile.opslimit <= crypto_pwhash_OPSLIMIT_MAX &&
+               profile.memlimit >= crypto_pwhash_MEMLIMIT_MIN && profile.memlimit <= crypto_pwhash_MEMLIMIT_MAX;
+    }
+
+    // Thời gian của một lần băm thử với profile
+    std::chrono::milliseconds measureHash(const HashProfile& profile) {
+        unsigned char key[32];
+        unsigned char salt[crypto_pwhash_SALTBYTES] = {};
+        const char password[] = "diemdanh-calibration";
+
+        const auto start = std::chrono::steady_clock::now();
+        if (crypto_pwhash(
+            key, sizeof(key),
+            password, sizeof(password) - 1,
+            salt,
+            profile.opslimit,
+            profile.memlimit,
+            crypto_pwhash_ALG_DEFAULT
+        ) != 0) {
+            throw std::runtime_error("Hashing failed");
+        }
+
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    }
+}
+
+std::filesystem::path HashProfile::defaultPath() {
+    // Thư mục cấu hình của người dùng: ghi được kể cả khi chương trình cài ở thư mục hệ thống,
+    // và mỗi người dùng có profile riêng
+#ifdef _WIN32
+    if (const wchar_t* appdata = ::_wgetenv(L"APPDATA"); appdata && *appdata)
+        return std::filesystem::path(appdata) / "diemdanh" / "hash.cfg";
+#else
+    if (const char* xdg = std::getenv("XDG_CONFIG_HOME"); xdg && *xdg == '/')
+        return std::filesystem::path(xdg) / "diemdanh" / "hash.cfg";
+    if (const char* home = std::getenv("HOME"); home && *home)
+        return std::filesystem::path(home) / ".config" / "diemdanh" / "hash.cfg";
+#endif
+    return "diemdanh_hash.cfg";
+}
+
+std::filesystem::path HashProfile::installedPath() {
+    // Thư mục chứa file thực thi, không phụ thuộc thư mục hiện hành lúc chạy
+    std::filesystem::path exe;
+#ifdef _WIN32
+    std::wstring buffer(MAX_PATH, L'\0');
+    for (;;) {
+        const DWORD n = GetModuleFileNameW(nullptr, buffer.data(), static_cast<DWORD>(buffer.size()));
+        if (n == 0)
+            break;
+        if (n < buffer.size()) {
+            buffer.resize(n);
+            exe = buffer;
+            break;
+        }
+        buffer.resize(buffer.size() * 2);
+    }
+#else
+    std::error_code ec;
+    exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+#endif
+
+    if (exe.empty())
+        return {};
+    return exe.parent_path() / "diemdanh_hash.cfg";
+}
+
+std::optional<HashProfile> HashProfile::load(const std::filesystem::path& file) {
+    std::ifstream in(file);
+    if (!in)
+        return std::nullopt;
+
+    HashProfile profile{ 0, 0 };
+    std::string key;
+    unsigned long long value = 0;
+    while (in >> key >> value) {
+        if (key == "opslimit")
+            profile.opslimit = value;
+        else if (key == "memlimit")
+            profile.memlimit = static_cast<std::size_t>(value);
+    }
+
+    if (!inLimits(profile))
+        return std::nullopt;
+    return profile;
+}
+
+void HashProfile::save(const std::filesystem::path& file) const {
+    std::ostringstream out;
+    out << "opslimit " << opslimit << "\n"
+        << "memlimit " << memlimit << "\n";
+
+    const auto dir = file.parent_path();
+    if (!dir.empty() && std::filesystem::create_directories(dir))
+        std::filesystem::permissions(dir, std::filesystem::perms::owner_all);
+    utility_csv::detail::write_atomic(file, out.str());
+}
+
+HashProfile HashProfile::current() {
+    std::lock_guard lock(profile_mutex);
+    if (!profile_current) {
+        profile_current = load(defaultPath());
+        if (!profile_current && !installedPath().empty())
+            profile_current = load(installedPath());
+        if (!profile_current)
+            profile_current = HashProfile{};
+    }
+    return *profile_current;
+}
+
+void HashProfile::setCurrent(const HashProfile& profile) {
+    if (!inLimits(profile))
+        throw std::invalid_argument("Hash profile out of range");
+
+    std::lock_guard lock(profile_mutex);
+    profile_current = profile;
+}
+
+HashCalibration calibrateHash(std::chrono::milliseconds target, std::size_t max_memlimit) {
+    using std::chrono::milliseconds;
+
+    const std::size_t min_memlimit = std::max<std::size_t>(crypto_pwhash_MEMLIMIT_MIN, 8u << 20);
+    max_memlimit = std::clamp<std::size_t>(max_memlimit, min_memlimit, crypto_pwhash_MEMLIMIT_MAX);
+
+    // Thời gian argon2 gần như tỉ lệ với mem * ops: chỉnh bộ nhớ trước, rồi mới tới ops
+    HashProfile profile{ crypto_pwhash_OPSLIMIT_MIN, std::min<std::size_t>(crypto_pwhash_MEMLIMIT_INTERACTIVE, max_memlimit) };
+    milliseconds latency = measureHash(profile);
+
+    while (latency > target && profile.memlimit / 2 >= min_memlimit) {
+        profile.memlimit /= 2;
+        latency = measureHash(profile);
+    }
+
+    while (latency * 2 <= target && profile.memlimit * 2 <= max_memlimit) {
+        profile.memlimit *= 2;
+        latency = measureHash(profile);
+    }
+
+    if (latency < target) {
+        const auto per_op = std::max<long long>(latency.count() / static_cast<long long>(profile.opslimit), 1);
+        const auto ops = static_cast<unsigned long long>(target.count() / per_op);
+        profile.opslimit = std::clamp<unsigned long long>(ops, profile.opslimit, crypto_pwhash_OPSLIMIT_MAX);
+        latency = measureHash(profile);
+    }
+
+    return { profile, latency };
+}
 
 // ================ Account ================
-Account::Account(const std::string& username, const std::string& raw_password) : _username(username) {
+Account::Account(const std::string& username, const std::string& raw_password)
+    : Account(username, raw_password, HashProfile::current()) {}
+
+Account::Account(const std::string& username, const std::string& raw_password, const HashProfile& profile) : _username(username) {
     char hash[crypto_pwhash_STRBYTES];
 
     if (crypto_pwhash_str(
         hash,
         raw_password.c_str(),
         raw_password.size(),
-        crypto_pwhash_OPSLIMIT_INTERACTIVE,
-        crypto_pwhash_MEMLIMIT_INTERACTIVE
+        profile.opslimit,
+        profile.memlimit
     ) != 0) {
         throw std::runtime_error("Hashing failed");
     }
@@ -25,10 +200,475 @@ bool Account::verifyPassword(const std::string& raw_password) const {
     ) == 0;
 }
 
+Account Account::fromHash(const std::string& username, const std::string& password_hash) {
+    // crypto_pwhash_str_needs_rehash trả về -1 khi chuỗi không phải hash hợp lệ
+    const HashProfile profile = HashProfile::current();
+    if (password_hash.empty() || password_hash.size() >= crypto_pwhash_STRBYTES ||
+        crypto_pwhash_str_needs_rehash(
+            password_hash.c_str(),
+            profile.opslimit,
+            profile.memlimit
+        ) == -1) {
+        throw std::invalid_argument("Invalid password hash for account: " + username);
+    }
+
+    Account account;
+    account._username = username;
+    account._password_hash = password_hash;
+    return account;
+}
+
+bool Account::needsRehash(const HashProfile& profile) const {
+    return crypto_pwhash_str_needs_rehash(_password_hash.c_str(), profile.opslimit, profile.memlimit) != 0;
+}
+
 const std::string& Account::getUsername() const {
     return _username;
 }
 
+const std::string& Account::getPasswordHash() const {
+    return _password_hash;
+}
+
+// ================ AccountStore ================
+namespace {
+    // File chứa hash mật khẩu (AccountStore, checkpoint) chỉ chủ sở hữu được đọc ghi
+    constexpr auto CREDENTIAL_PERMS = std::filesystem::perms::owner_read | std::filesystem::perms::owner_write;
+}
+
+AccountStore::AccountStore(std::filesystem::path file, VerificationScheduler* scheduler)
+    : _file(std::move(file)), _scheduler(scheduler) {
+    if (!std::filesystem::exists(_file))
+        return;
+
+    auto data = utility_csv::read_csv(_file);
+    auto username = data.handle<std::string_view>("username");
+    auto hash = data.handle<std::string_view>("password_hash");
+
+    _accounts.reserve(data.row_count());
+    for (const auto& row : data.rows)
+        add(Account::fromHash(std::string(username(row)), std::string(hash(row))));
+}
+
+AccountStore::~AccountStore() {
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+
+    if (_upgrader.joinable())
+        _upgrader.join();
+}
+
+void AccountStore::add(Account account) {
+    std::lock_guard lock(_mutex);
+    if (!_index.emplace(account.getUsername(), _accounts.size()).second)
+        throw std::invalid_argument("Duplicate account: " + account.getUsername());
+
+    _accounts.push_back(std::move(account));
+}
+
+bool AccountStore::remove(const std::string& username) {
+    std::lock_guard lock(_mutex);
+    auto it = _index.find(username);
+    if (it == _index.end())
+        return false;
+
+    // Đưa phần tử cuối vào chỗ trống để không phải dời cả mảng
+    const std::size_t pos = it->second;
+    _index.erase(it);
+    if (pos != _accounts.size() - 1) {
+        _accounts[pos] = std::move(_accounts.back());
+        _index[_accounts[pos].getUsername()] = pos;
+    }
+    _accounts.pop_back();
+    return true;
+}
+
+std::optional<Account> AccountStore::find(const std::string& username) const {
+    std::lock_guard lock(_mutex);
+    auto it = _index.find(username);
+    if (it == _index.end())
+        return std::nullopt;
+    return _accounts[it->second];
+}
+
+Verification AccountStore::login(const std::string& username, const std::string& raw_password) {
+    auto account = find(username);
+    if (!account)
+        return Verification::Denied;
+
+    const Verification result = _scheduler
+        ? _scheduler->verify(*account, raw_password)
+        : (account->verifyPassword(raw_password) ? Verification::Accepted : Verification::Denied);
+
+    if (result != Verification::Accepted || !account->needsRehash())
+        return result;
+
+    std::lock_guard lock(_mutex);
+    _upgrades.push_back({ username, raw_password, account->getPasswordHash() });
+    ++_pending;
+    if (!_upgrader.joinable())
+        _upgrader = std::thread(&AccountStore::upgradeLoop, this);
+    _wake.notify_one();
+    return Verification::Accepted;
+}
+
+void AccountStore::upgradeLoop() {
+    std::unique_lock lock(_mutex);
+    for (;;) {
+        _wake.wait(lock, [&] { return _stopping || !_upgrades.empty(); });
+        if (_upgrades.empty())
+            return;
+
+        std::size_t processed = 0;
+        while (!_upgrades.empty()) {
+            // Copy rồi xóa mật khẩu trong hàng đợi trước khi pop: move chuỗi ngắn (SSO)
+            // vẫn để lại các byte cũ trong phần tử bị pop
+            auto& front = _upgrades.front();
+            const std::string username = std::move(front.username);
+            const std::string verified_hash = std::move(front.verified_hash);
+            std::string password = front.password;
+            sodium_memzero(front.password.data(), front.password.size());
+            _upgrades.pop_front();
+            ++processed;
+
+            // Đăng nhập nhiều lần liên tiếp chỉ cần băm lại một lần; hash đã khác hash
+            // lúc xác thực nghĩa là mật khẩu đã đổi, không được ghi đè bằng mật khẩu cũ
+            auto current = [&]() -> Account* {
+                auto it = _index.find(username);
+                if (it == _index.end() || _accounts[it->second].getPasswordHash() != verified_hash)
+                    return nullptr;
+                return &_accounts[it->second];
+            };
+
+            std::optional<Account> upgraded;
+            if (auto* account = current(); account && account->needsRehash()) {
+                lock.unlock();
+                try {
+                    upgraded.emplace(username, password);
+                }
+                catch (const std::exception&) {
+                    // Giữ hash cũ, lần đăng nhập sau sẽ thử lại
+                }
+                lock.lock();
+            }
+            sodium_memzero(password.data(), password.size());
+
+            if (upgraded)
+                if (auto* account = current())
+                    *account = std::move(*upgraded);
+        }
+
+        lock.unlock();
+        try {
+            write();
+        }
+        catch (const std::exception&) {
+            // Hash mới vẫn nằm trong bộ nhớ và sẽ được ghi ở lần save() kế tiếp
+        }
+        lock.lock();
+
+        _pending -= processed;
+        if (_pending == 0)
+            _idle.notify_all();
+    }
+}
+
+void AccountStore::waitForUpgrades() {
+    std::unique_lock lock(_mutex);
+    _idle.wait(lock, [&] { return _pending == 0; });
+}
+
+std::vector<Account> AccountStore::accounts() const {
+    std::lock_guard lock(_mutex);
+    return _accounts;
+}
+
+std::size_t AccountStore::size() const {
+    std::lock_guard lock(_mutex);
+    return _accounts.size();
+}
+
+// Giữ _save_mutex từ lúc chụp dữ liệu tới khi ghi xong để các bản chụp xuống đĩa
+// đúng thứ tự; _mutex chỉ giữ lúc chụp để không chặn login. Thứ tự khóa: _save_mutex rồi _mutex
+void AccountStore::write() {
+    std::lock_guard save_lock(_save_mutex);
+
+    utility_csv::CSVData data{ { "username", "password_hash" }, {} };
+    {
+        std::lock_guard lock(_mutex);
+        data.rows.reserve(_accounts.size());
+        for (const auto& account : _accounts)
+            data.rows.push_back({ account.getUsername(), account.getPasswordHash() });
+    }
+
+    utility_csv::write_csv(_file, data, { .allow_empty = true, .permissions = CREDENTIAL_PERMS });
+}
+
+void AccountStore::save() {
+    write();
+}
+
+// ================ Provisioning ================
+namespace {
+    // Bộ nhớ còn dùng được (byte), 0 nếu không biết
+    std::uint64_t availableMemory() {
+#ifdef _WIN32
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status))
+            return status.ullAvailPhys;
+        return 0;
+#else
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key, unit;
+        std::uint64_t kb = 0;
+        while (meminfo >> key >> kb >> unit)
+            if (key == "MemAvailable:")
+                return kb * 1024;
+
+#ifdef _SC_AVPHYS_PAGES
+        const long pages = sysconf(_SC_AVPHYS_PAGES);
+        const long page_size = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && page_size > 0)
+            return static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(page_size);
+#endif
+        return 0;
+#endif
+    }
+
+    const utility_csv::Row CHECKPOINT_HEADERS = { "username", "password_hash" };
+
+    // Đọc các hash đã lưu; row hỏng (vd. bị ngắt giữa chừng khi đang ghi) bị bỏ qua
+    // và file được ghi lại sạch để có thể ghi nối tiếp
+    std::unordered_map<std::string, std::string> loadCheckpoint(const std::filesystem::path& file) {
+        std::unordered_map<std::string, std::string> saved;
+        if (!std::filesystem::exists(file) || std::filesystem::file_size(file) == 0)
+            return saved;
+
+        utility_csv::ValidationReport report;
+        auto data = utility_csv::read_csv(file, report);
+        if (data.headers() != CHECKPOINT_HEADERS)
+            throw std::runtime_error("CSV header mismatch: " + file.string());
+
+        utility_csv::CSVData clean{ CHECKPOINT_HEADERS, {} };
+        for (auto& row : data.rows) {
+            try {
+                Account::fromHash(row[0], row[1]);
+            }
+            catch (const std::invalid_argument&) {
+                continue;
+            }
+            saved.emplace(row[0], row[1]);
+            clean.rows.push_back(std::move(row));
+        }
+
+        if (!report.ok() || clean.rows.size() != data.rows.size())
+            utility_csv::write_csv(file, clean, { .allow_empty = true, .permissions = CREDENTIAL_PERMS });
+
+        return saved;
+    }
+}
+
+std::size_t hashingConcurrency() {
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::uint64_t memory = availableMemory();
+    if (memory == 0)
+        return cores;
+
+    // Chừa lại một phần tư cho phần còn lại của hệ thống
+    const std::uint64_t by_memory = memory / 4 * 3 / HashProfile::current().memlimit;
+    return static_cast<std::size_t>(std::clamp<std::uint64_t>(by_memory, 1, cores));
+}
+
+std::vector<Account> provisionAccounts(const std::vector<ProvisionRequest>& requests, const ProvisionOptions& options) {
+    std::vector<std::optional<Account>> results(requests.size());
+    ProvisionProgress progress{ 0, requests.size(), 0 };
+
+    std::unordered_map<std::string, std::string> saved;
+    if (!options.checkpoint.empty())
+        saved = loadCheckpoint(options.checkpoint);
+
+    std::vector<std::size_t> pending;
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        auto it = saved.find(requests[i].username);
+        if (it == saved.end()) {
+            pending.push_back(i);
+            continue;
+        }
+
+        results[i] = Account::fromHash(requests[i].username, it->second);
+        ++progress.resumed;
+    }
+    progress.done = progress.resumed;
+
+    std::optional<utility_csv::CSVAppender> checkpoint;
+    if (!options.checkpoint.empty())
+        checkpoint.emplace(options.checkpoint, CHECKPOINT_HEADERS, utility_csv::FlushPolicy::Flush, ',', true, CREDENTIAL_PERMS);
+
+    std::mutex mutex;
+    std::exception_ptr error;
+    std::atomic<std::size_t> next{ 0 };
+
+    auto worker = [&] {
+        for (std::size_t n = next++; n < pending.size(); n = next++) {
+            const auto& request = requests[pending[n]];
+            try {
+                Account account(request.username, request.raw_password);
+
+                std::lock_guard lock(mutex);
+                if (checkpoint)
+                    checkpoint->append({ account.getUsername(), account.getPasswordHash() });
+                results[pending[n]] = std::move(account);
+
+                ++progress.done;
+                if (options.on_progress)
+                    options.on_progress(progress);
+            }
+            catch (...) {
+                std::lock_guard lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+                next = pending.size();
+                return;
+            }
+        }
+    };
+
+    const std::size_t workers = std::min(
+        options.max_workers ? options.max_workers : hashingConcurrency(),
+        std::max<std::size_t>(pending.size(), 1)
+    );
+
+    std::vector<std::thread> pool;
+    for (std::size_t t = 0; t < workers; ++t)
+        pool.emplace_back(worker);
+    for (auto& t : pool)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    std::vector<Account> accounts;
+    accounts.reserve(results.size());
+    for (auto& account : results)
+        accounts.push_back(std::move(*account));
+    return accounts;
+}
+
+// ================ VerificationScheduler ================
+namespace {
+    // Bộ nhớ argon2 (byte) ghi trong hash dạng "$argon2id$v=19$m=65536,t=2,p=1$..."
+    std::size_t hashMemory(const std::string& hash) {
+        const auto pos = hash.find("$m=");
+        if (pos != std::string::npos) {
+            std::size_t kib = 0;
+            const char* begin = hash.data() + pos + 3;
+            auto [ptr, ec] = std::from_chars(begin, hash.data() + hash.size(), kib);
+            if (ec == std::errc{} && ptr != begin)
+                return kib * 1024;
+        }
+        return HashProfile::current().memlimit;
+    }
+}
+
+std::chrono::microseconds VerificationMetrics::averageWait() const {
+    if (admitted == 0)
+        return std::chrono::microseconds(0);
+    return std::chrono::duration_cast<std::chrono::microseconds>(total_wait / admitted);
+}
+
+VerificationScheduler::VerificationScheduler(const SchedulerOptions& options)
+    : _budget(options.memory_budget), _max_queue(options.max_queue), _deadline(options.deadline) {
+    if (_budget == 0) {
+        const std::uint64_t memory = availableMemory();
+        _budget = memory != 0
+            ? static_cast<std::size_t>(memory / 4 * 3)
+            : hashingConcurrency() * HashProfile::current().memlimit;
+    }
+}
+
+bool VerificationScheduler::admit(std::size_t cost) {
+    // Yêu cầu lớn hơn cả ngân sách vẫn chạy được, nhưng chỉ khi chạy một mình
+    cost = std::min(cost, _budget);
+
+    std::unique_lock lock(_mutex);
+    if (_queue.size() >= _max_queue) {
+        ++_metrics.rejected_full;
+        return false;
+    }
+
+    const Waiter waiter{ cost };
+    _queue.push_back(&waiter);
+    _metrics.queue_depth = _queue.size();
+    _metrics.max_queue_depth = std::max(_metrics.max_queue_depth, _queue.size());
+
+    const auto start = std::chrono::steady_clock::now();
+    const bool admitted = _cv.wait_until(lock, start + _deadline, [&] {
+        return _queue.front() == &waiter && _metrics.memory_in_use + cost <= _budget;
+    });
+
+    if (!admitted) {
+        _queue.erase(std::find(_queue.begin(), _queue.end(), &waiter));
+        _metrics.queue_depth = _queue.size();
+        ++_metrics.rejected_deadline;
+        _cv.notify_all(); // có thể đã đổi người đứng đầu hàng
+        return false;
+    }
+
+    _queue.pop_front();
+    const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    _metrics.queue_depth = _queue.size();
+    _metrics.memory_in_use += cost;
+    _metrics.in_flight++;
+    _metrics.max_in_flight = std::max(_metrics.max_in_flight, _metrics.in_flight);
+    _metrics.admitted++;
+    _metrics.total_wait += waited;
+    _metrics.max_wait = std::max(_metrics.max_wait, waited);
+
+    _cv.notify_all(); // người kế tiếp có thể cũng vừa ngân sách
+    return true;
+}
+
+void VerificationScheduler::release(std::size_t cost) {
+    {
+        std::lock_guard lock(_mutex);
+        _metrics.memory_in_use -= std::min(cost, _budget);
+        _metrics.in_flight--;
+    }
+    _cv.notify_all();
+}
+
+Verification VerificationScheduler::verify(const Account& account, const std::string& raw_password) {
+    const std::size_t cost = hashMemory(account.getPasswordHash());
+    if (!admit(cost))
+        return Verification::Overloaded;
+
+    bool ok = false;
+    try {
+        ok = account.verifyPassword(raw_password);
+    }
+    catch (...) {
+        release(cost);
+        throw;
+    }
+    release(cost);
+
+    return ok ? Verification::Accepted : Verification::Denied;
+}
+
+VerificationMetrics VerificationScheduler::metrics() const {
+    std::lock_guard lock(_mutex);
+    return _metrics;
+}
+
+std::size_t VerificationScheduler::memoryBudget() const {
+    return _budget;
+}
+
 // ================ Date ================
 
 DateTime::DateTime() : _tp{std::chrono::system_clock::now()} {}
@@ -58,6 +698,39 @@ DateTime DateTime::now()
     return DateTime();
 }
 
+std::optional<DateTime> DateTime::parse(std::string_view text)
+{
+    constexpr char separators[] = { '/', '/', ' ', ':', ':' };
+    int values[6] = { 0, 0, 0, 0, 0, 0 };
+
+    const char* p = text.data();
+    const char* end = text.data() + text.size();
+    int count = 0;
+
+    while (count < 6) {
+        auto [next, ec] = std::from_chars(p, end, values[count]);
+        if (ec != std::errc{})
+            return std::nullopt;
+
+        p = next;
+        ++count;
+
+        if (p == end || count == 6 || *p != separators[count - 1])
+            break;
+        ++p;
+    }
+
+    if (p != end || (count != 3 && count != 5 && count != 6))
+        return std::nullopt;
+
+    try {
+        return DateTime(values[0], values[1], values[2], values[3], values[4], values[5]);
+    }
+    catch (const std::invalid_argument&) {
+        return std::nullopt;
+    }
+}
+
 int DateTime::day() const
 {
     auto dp = floor<std::chrono::days>(_tp);
@@ -144,3 +817,13 @@ bool DateTime::operator>(const DateTime &other) const
 {
     return _tp > other._tp;
 }
+
+bool from_csv(std::string_view text, DateTime& out)
+{
+    auto parsed = DateTime::parse(text);
+    if (!parsed)
+        return false;
+
+    out = *parsed;
+    return true;
+}
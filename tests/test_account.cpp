@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "models.hpp"
 
+#include <atomic>
+
 TEST(AccountTest, UsernameShouldMatch) {
     Account acc("thienmai", "123456");
     EXPECT_EQ(acc.getUsername(), "thienmai");
@@ -14,4 +16,265 @@ TEST(AccountTest, CorrectPassword) {
 TEST(AccountTest, WrongPassword) {
     Account acc("thienmai", "123456");
     EXPECT_FALSE(acc.verifyPassword("wrong"));
-}
\ No newline at end of file
+}
+TEST(AccountTest, FromHashAdoptsStoredHash) {
+    Account original("thienmai", "123456");
+    Account restored = Account::fromHash("thienmai", original.getPasswordHash());
+
+    EXPECT_EQ(restored.getPasswordHash(), original.getPasswordHash());
+    EXPECT_TRUE(restored.verifyPassword("123456"));
+    EXPECT_FALSE(restored.verifyPassword("wrong"));
+}
+
+TEST(AccountTest, FromHashRejectsMalformedHash) {
+    EXPECT_THROW(Account::fromHash("a", ""), std::invalid_argument);
+    EXPECT_THROW(Account::fromHash("a", "123456"), std::invalid_argument);
+    EXPECT_THROW(Account::fromHash("a", "$argon2id$v=19$m=abc"), std::invalid_argument);
+}
+
+TEST(AccountTest, StoreRoundTripWithoutRehashing) {
+    auto file = std::filesystem::temp_directory_path() / "diemdanh_accounts.csv";
+    std::filesystem::remove(file);
+
+    {
+        AccountStore store(file);
+        store.add(Account("sv001", "matkhau1"));
+        store.add(Account("gv001", "matkhau2"));
+        EXPECT_THROW(store.add(Account::fromHash("sv001", store.find("gv001")->getPasswordHash())), std::invalid_argument);
+        store.save();
+    }
+
+    AccountStore loaded(file);
+    ASSERT_EQ(loaded.size(), 2u);
+    ASSERT_TRUE(loaded.find("gv001").has_value());
+    EXPECT_TRUE(loaded.find("gv001")->verifyPassword("matkhau2"));
+    EXPECT_FALSE(loaded.find("khong_co").has_value());
+
+    EXPECT_TRUE(loaded.remove("sv001"));
+    EXPECT_FALSE(loaded.remove("sv001"));
+    EXPECT_EQ(loaded.find("gv001")->getUsername(), "gv001");
+
+#ifndef _WIN32
+    EXPECT_EQ(std::filesystem::status(file).permissions() & std::filesystem::perms::all,
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+#endif
+
+    // Xóa hết tài khoản rồi lưu: file chỉ còn header, nạp lại được store rỗng
+    EXPECT_TRUE(loaded.remove("gv001"));
+    EXPECT_NO_THROW(loaded.save());
+    EXPECT_EQ(AccountStore(file).size(), 0u);
+}
+
+TEST(AccountTest, ProvisionResumesFromCheckpoint) {
+    auto checkpoint = std::filesystem::temp_directory_path() / "diemdanh_provision.csv";
+    std::filesystem::remove(checkpoint);
+
+    std::vector<ProvisionRequest> requests;
+    for (int i = 0; i < 6; ++i)
+        requests.push_back({ "sv" + std::to_string(i), "matkhau" + std::to_string(i) });
+
+    // Lần đầu bị ngắt sau 2 tài khoản
+    ProvisionOptions options;
+    options.checkpoint = checkpoint;
+    options.max_workers = 2;
+    options.on_progress = [](const ProvisionProgress& p) {
+        if (p.done == 2)
+            throw std::runtime_error("interrupted");
+    };
+    EXPECT_THROW(provisionAccounts(requests, options), std::runtime_error);
+
+    std::size_t last_done = 0, resumed = 0;
+    options.on_progress = [&](const ProvisionProgress& p) {
+        EXPECT_GT(p.done, last_done);
+        last_done = p.done;
+        resumed = p.resumed;
+    };
+    auto accounts = provisionAccounts(requests, options);
+
+    EXPECT_GE(resumed, 2u);
+    EXPECT_EQ(last_done, requests.size());
+    ASSERT_EQ(accounts.size(), requests.size());
+    for (std::size_t i = 0; i < requests.size(); ++i) {
+        EXPECT_EQ(accounts[i].getUsername(), requests[i].username);
+        EXPECT_TRUE(accounts[i].verifyPassword(requests[i].raw_password));
+    }
+
+    EXPECT_EQ(AccountStore(checkpoint).size(), requests.size());
+    EXPECT_GE(hashingConcurrency(), 1u);
+#ifndef _WIN32
+    EXPECT_EQ(std::filesystem::status(checkpoint).permissions() & std::filesystem::perms::all,
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+#endif
+}
+
+TEST(AccountTest, HashProfileCalibrationAndPersistence) {
+    auto result = calibrateHash(std::chrono::milliseconds(30), 16u << 20);
+    EXPECT_LE(result.profile.memlimit, 16u << 20);
+    EXPECT_GE(result.profile.opslimit, crypto_pwhash_OPSLIMIT_MIN);
+
+    auto file = std::filesystem::temp_directory_path() / "diemdanh_hash_test.cfg";
+    result.profile.save(file);
+    auto loaded = HashProfile::load(file);
+    ASSERT_TRUE(loaded.has_value());
+    EXPECT_EQ(*loaded, result.profile);
+
+#ifdef __linux__
+    // Ghi vào thư mục cấu hình của người dùng, không phải cạnh file thực thi;
+    // file cạnh file thực thi chỉ để đọc và không phụ thuộc thư mục hiện hành
+    const auto config = std::filesystem::temp_directory_path() / "diemdanh_config_test";
+    std::filesystem::remove_all(config);
+    const char* old_xdg = std::getenv("XDG_CONFIG_HOME");
+    const std::string saved_xdg = old_xdg ? old_xdg : "";
+    ::setenv("XDG_CONFIG_HOME", config.c_str(), 1);
+
+    const auto path = HashProfile::defaultPath();
+    EXPECT_EQ(path, config / "diemdanh" / "hash.cfg");
+    result.profile.save(path);
+    EXPECT_EQ(HashProfile::load(path), result.profile);
+    EXPECT_EQ(std::filesystem::status(path.parent_path()).permissions() & std::filesystem::perms::all,
+              std::filesystem::perms::owner_all);
+
+    ::unsetenv("XDG_CONFIG_HOME");
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        EXPECT_EQ(HashProfile::defaultPath(), std::filesystem::path(home) / ".config" / "diemdanh" / "hash.cfg");
+    }
+    if (old_xdg)
+        ::setenv("XDG_CONFIG_HOME", saved_xdg.c_str(), 1);
+    std::filesystem::remove_all(config);
+
+    EXPECT_EQ(HashProfile::installedPath().filename(), "diemdanh_hash.cfg");
+    EXPECT_TRUE(HashProfile::installedPath().is_absolute());
+#endif
+
+    HashProfile light{ crypto_pwhash_OPSLIMIT_MIN, 8u << 20 };
+    Account acc("thienmai", "123456", light);
+    EXPECT_NE(acc.getPasswordHash().find("m=8192,t=1"), std::string::npos);
+    EXPECT_TRUE(Account::fromHash("thienmai", acc.getPasswordHash()).verifyPassword("123456"));
+
+    EXPECT_FALSE(HashProfile::load(std::filesystem::temp_directory_path() / "diemdanh_khong_co.cfg").has_value());
+    EXPECT_THROW(HashProfile::setCurrent({ 0, 0 }), std::invalid_argument);
+}
+
+TEST(AccountTest, LoginUpgradesOutdatedHashInBackground) {
+    auto file = std::filesystem::temp_directory_path() / "diemdanh_rehash.csv";
+    std::filesystem::remove(file);
+
+    const HashProfile original = HashProfile::current();
+    const HashProfile light{ crypto_pwhash_OPSLIMIT_MIN, 8u << 20 };
+    const HashProfile stronger{ crypto_pwhash_OPSLIMIT_MIN + 1, 8u << 20 };
+
+    HashProfile::setCurrent(light);
+    {
+        AccountStore store(file);
+        store.add(Account("sv001", "matkhau1"));
+        store.save();
+    }
+
+    HashProfile::setCurrent(stronger);
+    {
+        AccountStore store(file);
+        EXPECT_TRUE(store.find("sv001")->needsRehash());
+        EXPECT_EQ(store.login("sv001", "sai"), Verification::Denied);
+        EXPECT_EQ(store.login("sv001", "matkhau1"), Verification::Accepted);
+        EXPECT_EQ(store.login("sv001", "matkhau1"), Verification::Accepted);
+        store.waitForUpgrades();
+        EXPECT_FALSE(store.find("sv001")->needsRehash());
+    }
+
+    AccountStore reloaded(file);
+    EXPECT_FALSE(reloaded.find("sv001")->needsRehash());
+    EXPECT_EQ(reloaded.login("sv001", "matkhau1"), Verification::Accepted);
+    EXPECT_EQ(reloaded.login("khong_co", "matkhau1"), Verification::Denied);
+
+    // Đổi mật khẩu ngay sau khi đăng nhập: lần nâng cấp đang chờ không được ghi lại mật khẩu cũ
+    HashProfile::setCurrent(light);
+    {
+        AccountStore store(file);
+        store.remove("sv001");
+        store.add(Account("sv001", "matkhau1"));
+        HashProfile::setCurrent(stronger);
+        EXPECT_EQ(store.login("sv001", "matkhau1"), Verification::Accepted);
+        store.remove("sv001");
+        store.add(Account("sv001", "matkhau2", light));
+        store.waitForUpgrades();
+        EXPECT_EQ(store.login("sv001", "matkhau1"), Verification::Denied);
+        EXPECT_EQ(store.login("sv001", "matkhau2"), Verification::Accepted);
+        store.waitForUpgrades();
+    }
+
+    HashProfile::setCurrent(original);
+}
+
+TEST(AccountTest, LoginGoesThroughScheduler) {
+    auto file = std::filesystem::temp_directory_path() / "diemdanh_login_scheduler.csv";
+    std::filesystem::remove(file);
+
+    const HashProfile light{ crypto_pwhash_OPSLIMIT_MIN, 8u << 20 };
+    {
+        AccountStore store(file);
+        store.add(Account("sv001", "matkhau1", light));
+        store.save();
+    }
+
+    VerificationScheduler scheduler({ .memory_budget = 8u << 20, .max_queue = 4, .deadline = std::chrono::seconds(30) });
+    AccountStore store(file, &scheduler);
+    EXPECT_EQ(store.login("sv001", "matkhau1"), Verification::Accepted);
+    EXPECT_EQ(store.login("sv001", "sai"), Verification::Denied);
+    EXPECT_EQ(scheduler.metrics().admitted, 2u);
+
+    // Hàng đợi không nhận thêm ai: login trả về Overloaded cho người gọi
+    VerificationScheduler full({ .memory_budget = 8u << 20, .max_queue = 0, .deadline = std::chrono::seconds(30) });
+    AccountStore busy(file, &full);
+    EXPECT_EQ(busy.login("sv001", "matkhau1"), Verification::Overloaded);
+    EXPECT_EQ(full.metrics().rejected_full, 1u);
+}
+
+TEST(AccountTest, SchedulerBoundsConcurrentVerifications) {
+    const HashProfile light{ crypto_pwhash_OPSLIMIT_MIN, 8u << 20 };
+    const Account account("sv001", "matkhau1", light);
+
+    VerificationScheduler scheduler({ .memory_budget = 2 * (8u << 20), .max_queue = 64, .deadline = std::chrono::seconds(30) });
+
+    std::vector<std::thread> threads;
+    std::atomic<int> accepted = 0, denied = 0;
+    for (int t = 0; t < 6; ++t)
+        threads.emplace_back([&, t] {
+            auto result = scheduler.verify(account, t % 2 ? "matkhau1" : "sai");
+            (result == Verification::Accepted ? accepted : denied)++;
+        });
+    for (auto& t : threads)
+        t.join();
+
+    auto metrics = scheduler.metrics();
+    EXPECT_EQ(accepted, 3);
+    EXPECT_EQ(denied, 3);
+    EXPECT_EQ(metrics.admitted, 6u);
+    EXPECT_LE(metrics.max_in_flight, 2u);
+    EXPECT_EQ(metrics.in_flight, 0u);
+    EXPECT_EQ(metrics.memory_in_use, 0u);
+    EXPECT_LE(metrics.averageWait(), metrics.max_wait);
+}
+
+TEST(AccountTest, SchedulerRejectsPastDeadline) {
+    const HashProfile light{ crypto_pwhash_OPSLIMIT_MIN, 8u << 20 };
+    const Account account("sv001", "matkhau1", light);
+
+    VerificationScheduler scheduler({ .memory_budget = 8u << 20, .max_queue = 2, .deadline = std::chrono::milliseconds(0) });
+
+    std::vector<std::thread> threads;
+    std::atomic<int> overloaded = 0, accepted = 0;
+    for (int t = 0; t < 8; ++t)
+        threads.emplace_back([&] {
+            for (int i = 0; i < 3; ++i)
+                (scheduler.verify(account, "matkhau1") == Verification::Overloaded ? overloaded : accepted)++;
+        });
+    for (auto& t : threads)
+        t.join();
+
+    auto metrics = scheduler.metrics();
+    EXPECT_EQ(overloaded + accepted, 24);
+    EXPECT_GT(overloaded, 0);
+    EXPECT_EQ(metrics.rejected_full + metrics.rejected_deadline, static_cast<std::size_t>(overloaded));
+    EXPECT_LE(metrics.max_in_flight, 1u);
+    EXPECT_LE(metrics.max_queue_depth, 2u);
+}
@@ -0,0 +1,813 @@
+#include <gtest/gtest.h>
+#include "utility.hpp"
+#include "models.hpp"
+
+namespace fs = std::filesystem;
+
+static fs::path writeTemp(const std::string& name, const std::string& content) {
+    fs::path file = fs::temp_directory_path() / ("diemdanh_" + name);
+    std::ofstream ofs(file, std::ios::binary);
+    ofs << content;
+    return file;
+}
+
+TEST(CSVTest, ReadCSV) {
+    auto file = writeTemp("read.csv", "mssv,ten,lop\n001,An,CTK47\n002,Binh,CTK48\n");
+    auto data = utility_csv::read_csv(file);
+
+    ASSERT_EQ(data.column_count(), 3u);
+    ASSERT_EQ(data.row_count(), 2u);
+    EXPECT_EQ(data.rows[1][1], "Binh");
+}
+
+TEST(CSVTest, ReadCSVIntegrityErrorThrows) {
+    auto file = writeTemp("broken.csv", "mssv,ten\n001,An\n002\n");
+    EXPECT_THROW(utility_csv::read_csv(file), std::runtime_error);
+}
+
+TEST(CSVTest, ColumnarMatchesRows) {
+    auto file = writeTemp("columnar.csv", "mssv,ten,lop\n001, An ,CTK47\n002,\"Binh, Tran\",CTK48\n003,,CTK48\n");
+    auto rows = utility_csv::read_csv(file);
+    auto columns = utility_csv::read_csv_columnar(file);
+
+    ASSERT_EQ(columns.row_count(), rows.row_count());
+    ASSERT_EQ(columns.headers, rows.headers());
+    for (std::size_t r = 0; r < rows.row_count(); ++r)
+        EXPECT_EQ(columns.row(r), rows.rows[r]);
+
+    EXPECT_EQ(columns.cell(1, 1), "Binh, Tran");
+    EXPECT_EQ(columns.cell(2, 1), "");
+}
+
+TEST(CSVTest, ForEachRowStreamsViews) {
+    auto file = writeTemp("stream.csv", "mssv,trang_thai\n001,co mat\n002,vang\n003,vang\n");
+
+    std::size_t absent = 0;
+    auto visited = utility_csv::for_each_row(file, [&](const utility_csv::RowView& row) {
+        EXPECT_EQ(row.headers().size(), 2u);
+        if (row[1] == "vang")
+            ++absent;
+    });
+
+    EXPECT_EQ(visited, 3u);
+    EXPECT_EQ(absent, 2u);
+}
+
+TEST(CSVTest, ForEachRowStopsEarly) {
+    auto file = writeTemp("stream_stop.csv", "mssv\n001\n002\n003\n");
+
+    std::string found;
+    auto visited = utility_csv::for_each_row(file, [&](const utility_csv::RowView& row) {
+        found = row[0];
+        return row[0] != "002";
+    });
+
+    EXPECT_EQ(visited, 2u);
+    EXPECT_EQ(found, "002");
+}
+
+// Còn file tạm nào dạng "<tên file>.<...>.tmp" nằm cạnh file không
+static bool hasTempSibling(const fs::path& file) {
+    const auto prefix = file.filename().string() + ".";
+    for (const auto& entry : fs::directory_iterator(file.parent_path())) {
+        const auto name = entry.path().filename().string();
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 && entry.path().extension() == ".tmp")
+            return true;
+    }
+    return false;
+}
+
+static std::string makeRoster(std::size_t rows) {
+    std::string content = "mssv,ho_ten,ghi_chu,trang_thai\n";
+    for (std::size_t i = 0; i < rows; ++i) {
+        content += std::to_string(100000 + i) + ",Sinh vien " + std::to_string(i) + ",";
+        if (i % 97 == 0)
+            content += "\"nhieu dong\nva \"\"trich dan\"\", co dau phay\"";
+        else
+            content += "binh thuong";
+        content += (i % 3 == 0) ? ",vang\r\n" : ",co mat\n";
+    }
+    return content;
+}
+
+TEST(CSVTest, ParallelMatchesSerial) {
+    auto file = writeTemp("parallel.csv", makeRoster(60000));
+    ASSERT_GT(fs::file_size(file), 2u * utility_csv::detail::PARALLEL_MIN_CHUNK);
+
+    auto serial = utility_csv::read_csv(file);
+    auto parallel = utility_csv::read_csv_parallel(file, ',', true, 4);
+
+    EXPECT_EQ(parallel.headers(), serial.headers());
+    ASSERT_EQ(parallel.row_count(), serial.row_count());
+    EXPECT_EQ(parallel.rows, serial.rows);
+}
+
+TEST(CSVTest, ParallelReportsSameIntegrityLine) {
+    auto content = makeRoster(60000);
+    content += "999999,thieu cot\n";
+    auto file = writeTemp("parallel_broken.csv", content);
+
+    std::string serial, parallel;
+    try { utility_csv::read_csv(file); } catch (const std::runtime_error& e) { serial = e.what(); }
+    try { utility_csv::read_csv_parallel(file, ',', true, 4); } catch (const std::runtime_error& e) { parallel = e.what(); }
+
+    EXPECT_FALSE(serial.empty());
+    EXPECT_EQ(parallel, serial);
+}
+
+TEST(CSVTest, AppendMatchesFullWrite) {
+    utility_csv::CSVData all{ { "mssv", "ghi_chu" }, { { "001", "co mat" }, { "002", "di muon, \"xin phep\"" } } };
+    auto full = fs::temp_directory_path() / "diemdanh_append_full.csv";
+    utility_csv::write_csv(full, all);
+
+    auto file = fs::temp_directory_path() / "diemdanh_append.csv";
+    fs::remove(file);
+    {
+        utility_csv::CSVAppender appender(file, all.headers());
+        appender.append(all.rows[0]);
+    }
+    utility_csv::append_csv(file, { all.headers(), { all.rows[1] } }, utility_csv::FlushPolicy::Sync);
+
+    std::ifstream a(full, std::ios::binary), b(file, std::ios::binary);
+    std::string expected((std::istreambuf_iterator<char>(a)), {}), actual((std::istreambuf_iterator<char>(b)), {});
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(CSVTest, AppendUsesFileDelimiter) {
+    auto file = writeTemp("append_semicolon.csv", "mssv; ghi_chu\n001; co mat\n");
+    {
+        utility_csv::CSVAppender appender(file, { "mssv", "ghi_chu" }, utility_csv::FlushPolicy::Flush, ';');
+        appender.append({ "002", "vang; khong phep" });
+    }
+    EXPECT_THROW(utility_csv::CSVAppender(file, { "mssv", "ghi_chu" }), std::runtime_error);
+
+    auto data = utility_csv::read_csv(file, ';');
+    ASSERT_EQ(data.row_count(), 2u);
+    EXPECT_EQ(data.rows[1][1], "vang; khong phep");
+}
+
+TEST(CSVTest, AppendRejectsHeaderMismatch) {
+    auto file = writeTemp("append_mismatch.csv", "mssv,ten\n001,An");
+    EXPECT_THROW(utility_csv::CSVAppender(file, { "mssv", "lop" }), std::runtime_error);
+
+    utility_csv::append_csv(file, { { "mssv", "ten" }, { { "002", "Binh" } } });
+    auto data = utility_csv::read_csv(file);
+    ASSERT_EQ(data.row_count(), 2u);
+    EXPECT_EQ(data.rows[1][1], "Binh");
+}
+
+TEST(CSVTest, AtomicWriteLeavesNoTempFile) {
+    auto file = fs::temp_directory_path() / "diemdanh_atomic.csv";
+    utility_csv::write_csv(file, { { "mssv" }, { { "001" } } });
+    utility_csv::write_csv(file, { { "mssv" }, { { "001" }, { "002" } } });
+
+    EXPECT_FALSE(hasTempSibling(file));
+    EXPECT_EQ(utility_csv::read_csv(file).row_count(), 2u);
+}
+
+#ifndef _WIN32
+TEST(CSVTest, AtomicWriteKeepsPermissions) {
+    auto file = fs::temp_directory_path() / "diemdanh_atomic_perms.csv";
+    utility_csv::write_csv(file, { { "mssv" }, { { "001" } } });
+    fs::permissions(file, fs::perms::owner_read | fs::perms::owner_write);
+
+    // File tạm cũ trùng tên kiểu ".tmp" không được bị ghi đè hay làm hỏng lần ghi
+    std::ofstream(file.string() + ".tmp") << "khong dong";
+    utility_csv::write_csv(file, { { "mssv" }, { { "001" }, { "002" } } });
+
+    EXPECT_EQ(fs::status(file).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write);
+    EXPECT_EQ(utility_csv::read_csv(file).row_count(), 2u);
+    fs::remove(file.string() + ".tmp");
+}
+#endif
+
+TEST(CSVTest, SaveBatchCoalescesAndCommits) {
+    auto a = fs::temp_directory_path() / "diemdanh_batch_a.csv";
+    auto b = fs::temp_directory_path() / "diemdanh_batch_b.csv";
+    utility_csv::write_csv(a, { { "mssv" }, { { "old" } } });
+
+    utility_csv::SaveBatch batch;
+    batch.save(a, { { "mssv" }, { { "001" } } });
+    batch.save(b, { { "mssv" }, { { "002" } } });
+    batch.save(a, { { "mssv" }, { { "003" } } });
+    EXPECT_EQ(batch.size(), 2u);
+    EXPECT_EQ(utility_csv::read_csv(a).rows[0][0], "old");
+
+    batch.commit();
+    EXPECT_EQ(utility_csv::read_csv(a).rows[0][0], "003");
+    EXPECT_EQ(utility_csv::read_csv(b).rows[0][0], "002");
+
+    // WriteOptions theo từng file: cho phép file rỗng, quyền riêng, index đi kèm
+    auto c = fs::temp_directory_path() / "diemdanh_batch_c.csv";
+    fs::remove(c);
+    EXPECT_THROW(batch.save(c, { { "mssv" } }), std::runtime_error);
+    batch.save(c, { { "mssv" } }, { .allow_empty = true });
+    batch.save(a, { { "mssv" }, { { "004" }, { "005" } } }, {
+        .index_column = "mssv",
+        .permissions = fs::perms::owner_read | fs::perms::owner_write
+    });
+    batch.commit();
+    EXPECT_TRUE(utility_csv::read_csv(c).empty());
+    auto index = utility_csv::CSVIndex::open(a, "mssv");
+    ASSERT_TRUE(index.has_value());
+    EXPECT_EQ(index->find("005").front()[0], "005");
+#ifndef _WIN32
+    EXPECT_EQ(fs::status(a).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write);
+#endif
+}
+
+TEST(CSVTest, SnapshotRoundTripAndStaleness) {
+    auto file = fs::temp_directory_path() / "diemdanh_snapshot.csv";
+    utility_csv::CSVData data{ { "mssv", "trang_thai" }, { { "001", "co mat" }, { "002", "vang" }, { "003", "vang" } } };
+    utility_csv::write_csv(file, data);
+    fs::remove(utility_csv::snapshot_path(file));
+
+    EXPECT_FALSE(utility_csv::Snapshot::open(file).has_value());
+
+    auto built = utility_csv::Snapshot::load(file);
+    EXPECT_EQ(built.to_csv_data().rows, data.rows);
+
+    auto mapped = utility_csv::Snapshot::open(file);
+    ASSERT_TRUE(mapped.has_value());
+    EXPECT_EQ(mapped->row_count(), 3u);
+    EXPECT_EQ(mapped->header(1), "trang_thai");
+    EXPECT_EQ(mapped->cell(2, 1), "vang");
+
+    data.rows.push_back({ "004", "co mat" });
+    utility_csv::write_csv(file, data);
+    EXPECT_FALSE(utility_csv::Snapshot::open(file).has_value());
+    EXPECT_EQ(utility_csv::Snapshot::load(file).row_count(), 4u);
+}
+
+TEST(CSVTest, SnapshotRejectsCorruption) {
+    auto file = fs::temp_directory_path() / "diemdanh_snapshot_bad.csv";
+    utility_csv::CSVData data{ { "mssv" }, { { "001" } } };
+    utility_csv::write_csv(file, data);
+    utility_csv::write_snapshot(file, data);
+    ASSERT_TRUE(utility_csv::Snapshot::open(file).has_value());
+
+    auto patch = [&](std::streamoff at, std::uint32_t value) {
+        std::fstream fsnap(utility_csv::snapshot_path(file), std::ios::binary | std::ios::in | std::ios::out);
+        fsnap.seekp(at);
+        fsnap.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    // Id header cột nằm trong phần có checksum
+    patch(64, 7);
+    EXPECT_FALSE(utility_csv::Snapshot::open(file).has_value());
+
+    // Byte chuỗi cũng nằm trong phần có checksum
+    utility_csv::write_snapshot(file, data);
+    patch(static_cast<std::streamoff>(fs::file_size(utility_csv::snapshot_path(file))) - 4, 0x21212121u);
+    EXPECT_FALSE(utility_csv::Snapshot::open(file).has_value());
+
+    // Id trong record không được băm nhưng phải bị chặn khi truy cập
+    utility_csv::write_snapshot(file, data);
+    patch(64 + 4, 0xFFFFFFFFu);
+    auto snapshot = utility_csv::Snapshot::open(file);
+    ASSERT_TRUE(snapshot.has_value());
+    EXPECT_EQ(snapshot->header(0), "mssv");
+    EXPECT_THROW(snapshot->cell(0, 0), std::runtime_error);
+}
+
+struct AttendanceRecord {
+    std::string mssv;
+    int so_buoi_vang = 0;
+    double ti_le = 0;
+    DateTime thoi_gian;
+};
+
+template <>
+struct utility_csv::CSVSchema<AttendanceRecord> {
+    static constexpr auto columns = std::make_tuple(
+        utility_csv::column("mssv", &AttendanceRecord::mssv),
+        utility_csv::column("so_buoi_vang", &AttendanceRecord::so_buoi_vang),
+        utility_csv::column("ti_le", &AttendanceRecord::ti_le),
+        utility_csv::column("thoi_gian", &AttendanceRecord::thoi_gian)
+    );
+};
+
+TEST(CSVTest, ReadTypedRecords) {
+    auto file = writeTemp("typed.csv",
+        "thoi_gian,ghi_chu,mssv,so_buoi_vang,ti_le\n"
+        "01/09/2025 07:00:00,,001,2,0.25\n"
+        "02/09/2025,muon,002,0,0\n");
+
+    auto records = utility_csv::read_csv_as<AttendanceRecord>(file);
+
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].mssv, "001");
+    EXPECT_EQ(records[0].so_buoi_vang, 2);
+    EXPECT_DOUBLE_EQ(records[0].ti_le, 0.25);
+    EXPECT_EQ(records[0].thoi_gian.hour(), 7);
+    EXPECT_EQ(records[1].thoi_gian.day(), 2);
+}
+
+TEST(CSVTest, ReadTypedRecordsRejectsBadCell) {
+    auto file = writeTemp("typed_bad.csv", "mssv,so_buoi_vang,ti_le,thoi_gian\n001,hai,0,01/09/2025\n");
+    EXPECT_THROW(utility_csv::read_csv_as<AttendanceRecord>(file), std::runtime_error);
+}
+
+TEST(CSVTest, ProjectionCopiesOnlyRequestedColumns) {
+    auto file = writeTemp("projection.csv", "mssv,ho_ten,lop,trang_thai\n001,An,CTK47,vang\n002,Binh,CTK48,co mat\n");
+
+    auto data = utility_csv::read_csv(file, utility_csv::Projection{ .names = { "trang_thai", "mssv" } });
+    EXPECT_EQ(data.headers(), (utility_csv::Row{ "trang_thai", "mssv" }));
+    ASSERT_EQ(data.row_count(), 2u);
+    EXPECT_EQ(data.rows[1], (utility_csv::Row{ "co mat", "002" }));
+
+    auto columns = utility_csv::read_csv_columnar(file, utility_csv::Projection{ .indices = { 2 } });
+    EXPECT_EQ(columns.column_count(), 1u);
+    EXPECT_EQ(columns.cell(1, 0), "CTK48");
+
+    EXPECT_THROW(utility_csv::read_csv(file, utility_csv::Projection{ .names = { "email" } }), std::runtime_error);
+    EXPECT_THROW(utility_csv::read_csv(file, utility_csv::Projection{ .indices = { 4 } }), std::runtime_error);
+}
+
+TEST(CSVTest, UnquotedFastPathMatchesParser) {
+    const utility_csv::Row headers{ "a", "b", "c" };
+    const std::vector<std::string> inputs = {
+        "1,2,3\n4,5,6\n",
+        "1, 2 ,\t3\r\n\r\n4,,6\r\n",
+        "1,2,3\n\n\n4,5,6",
+        "1,2,3\n4,5,",
+        "1,2,3\n4,5,6\n   ",
+        std::string(70, 'x') + ",y," + std::string(130, 'z') + "\n" + std::string(40, ' ') + "p,q,r\n",
+    };
+
+    for (const auto& input : inputs) {
+        for (bool trim : { true, false }) {
+            utility_csv::detail::ChunkResult fast, slow;
+            utility_csv::detail::split_unquoted(input, headers, ',', trim, true, fast);
+            utility_csv::detail::parse_quoted(input, headers, ',', trim, slow);
+
+            EXPECT_EQ(fast.rows, slow.rows) << input;
+            EXPECT_EQ(fast.bad_row, slow.bad_row) << input;
+
+            utility_csv::detail::ChunkResult scalar;
+            utility_csv::detail::split_unquoted(input, headers, ',', trim, true, scalar,
+                                                utility_csv::detail::special_mask_scalar);
+            EXPECT_EQ(scalar.rows, fast.rows) << input;
+        }
+    }
+}
+
+TEST(CSVTest, ParallelSingleThreadUsesFastPath) {
+    std::string content = "mssv;ho_ten;trang_thai\n";
+    for (int i = 0; i < 80000; ++i)
+        content += std::to_string(i) + "; Sinh vien " + std::to_string(i) + " ;" + (i % 2 ? "vang\r\n" : "co mat\n");
+    auto file = writeTemp("fast_path.csv", content);
+
+    auto serial = utility_csv::read_csv(file, ';');
+    auto fast = utility_csv::read_csv_parallel(file, ';', true, 1);
+    EXPECT_EQ(fast.rows, serial.rows);
+}
+
+TEST(CSVTest, ValidationCollectsEveryBadRow) {
+    const std::string content = "mssv,ten\n001,An\n002\n003,Cuong\n004,Dung,thua\n005,Em\n";
+    auto file = writeTemp("validate.csv", content);
+
+    utility_csv::ValidationReport report;
+    auto data = utility_csv::read_csv(file, report, utility_csv::BadRowPolicy::Quarantine);
+
+    ASSERT_EQ(data.row_count(), 3u);
+    EXPECT_EQ(data.rows[2][0], "005");
+
+    ASSERT_EQ(report.errors.size(), 2u);
+    EXPECT_EQ(report.errors[0].line, 3u);
+    EXPECT_EQ(report.errors[0].actual, 1u);
+    EXPECT_EQ(report.errors[0].byte_offset, content.find("002"));
+    EXPECT_EQ(report.errors[1].line, 5u);
+    EXPECT_EQ(report.errors[1].expected, 2u);
+    EXPECT_EQ(report.errors[1].actual, 3u);
+    EXPECT_EQ(report.errors[1].byte_offset, content.find("004"));
+
+    ASSERT_EQ(report.quarantined.size(), 2u);
+    EXPECT_EQ(report.quarantined[1][2], "thua");
+}
+
+TEST(CSVTest, ValidationSkipsWithoutQuarantine) {
+    auto file = writeTemp("validate_skip.csv", "mssv,ten\n\"001\",\"An\nB\"\n002\n");
+
+    utility_csv::ValidationReport report;
+    auto data = utility_csv::read_csv(file, report);
+
+    EXPECT_EQ(data.row_count(), 1u);
+    ASSERT_EQ(report.errors.size(), 1u);
+    EXPECT_EQ(report.errors[0].byte_offset, 22u);
+    EXPECT_TRUE(report.quarantined.empty());
+}
+
+TEST(CSVTest, WriteMatchesDelimWriterOutput) {
+    utility_csv::CSVData data{ { "mssv", "ghi_chu" }, {
+        { "001", "" },
+        { "002", "khong can quote nhung dai hon mười sáu byte" },
+        { "003", "dai hon mười sáu byte roi moi co \"quote\"" },
+        { "004", "xuong\ndong" },
+        { "005", "co, dau phay" },
+        { "006", "\r" },
+        { "007" },
+    } };
+
+    std::ostringstream expected;
+    {
+        auto writer = csv::make_csv_writer(expected);
+        writer << data.headers();
+        for (const auto& row : data.rows)
+            writer << row;
+    }
+
+    auto file = fs::temp_directory_path() / "diemdanh_buffered.csv";
+    utility_csv::write_csv(file, data);
+
+    std::ifstream in(file, std::ios::binary);
+    std::string actual((std::istreambuf_iterator<char>(in)), {});
+    EXPECT_EQ(actual, expected.str());
+}
+
+TEST(CSVTest, ParallelWriteIsByteIdentical) {
+    utility_csv::CSVData data{ { "mssv", "ho_ten", "ghi_chu" }, {} };
+    for (int i = 0; i < 100000; ++i)
+        data.rows.push_back({ std::to_string(i), "Sinh vien " + std::to_string(i), i % 11 ? "" : "co \"ly do\", xin phep" });
+
+    auto serial = fs::temp_directory_path() / "diemdanh_write_serial.csv";
+    auto parallel = fs::temp_directory_path() / "diemdanh_write_parallel.csv";
+    utility_csv::write_csv(serial, data);
+    utility_csv::write_csv(parallel, data, { .threads = 4 });
+
+    std::ifstream a(serial, std::ios::binary), b(parallel, std::ios::binary);
+    std::string expected((std::istreambuf_iterator<char>(a)), {}), actual((std::istreambuf_iterator<char>(b)), {});
+    EXPECT_EQ(actual.size(), expected.size());
+    EXPECT_TRUE(actual == expected);
+}
+
+TEST(CSVTest, IndexFindsRowsAndRebuildsWhenStale) {
+    auto file = fs::temp_directory_path() / "diemdanh_index.csv";
+    utility_csv::CSVData data{ { "mssv", "ngay", "ghi_chu" }, {
+        { "002", "01/10/2024", "" },
+        { "001", "01/10/2024", "di tre\nco phep" },
+        { "002", "02/10/2024", "vang, khong phep" },
+    } };
+    utility_csv::write_csv(file, data, { .index_column = "mssv" });
+
+    auto index = utility_csv::CSVIndex::open(file, "mssv");
+    ASSERT_TRUE(index.has_value());
+    EXPECT_TRUE(index->contains("001"));
+    EXPECT_FALSE(index->contains("003"));
+
+    auto rows = index->find("002");
+    ASSERT_EQ(rows.size(), 2u);
+    EXPECT_EQ(rows[0], data.rows[0]);
+    EXPECT_EQ(rows[1], data.rows[2]);
+    EXPECT_EQ(index->find("001").front(), data.rows[1]);
+
+    // Ghi lại file mà không cập nhật index: lần tra kế tiếp phải tự dựng lại
+    data.rows.insert(data.rows.begin(), { "003", "03/10/2024", "" });
+    utility_csv::write_csv(file, data);
+    EXPECT_FALSE(utility_csv::CSVIndex::open(file, "mssv").has_value());
+    EXPECT_EQ(index->find("003").size(), 1u);
+    EXPECT_EQ(index->find("002")[1], data.rows[3]);
+
+    data.rows.push_back({ "004", "04/10/2024", "" });
+    utility_csv::write_csv(file, data);
+    EXPECT_TRUE(index->contains("004"));
+    EXPECT_EQ(index->offsets("004").size(), 1u);
+
+    // Row ngắn hơn header: cell khóa thiếu được coi là rỗng
+    utility_csv::write_csv(file, { { "mssv", "ngay", "ghi_chu" }, { { "005", "05/10/2024" }, { "006" } } },
+        { .index_column = "ghi_chu" });
+    auto short_index = utility_csv::CSVIndex::open(file, "ghi_chu");
+    ASSERT_TRUE(short_index.has_value());
+    EXPECT_EQ(short_index->offsets("").size(), 2u);
+
+    utility_csv::write_csv(file, data);
+    auto read = utility_csv::read_csv(file);
+    utility_csv::write_index(file, read, "ngay");
+    EXPECT_EQ(utility_csv::CSVIndex::load(file, "ngay").find("01/10/2024").size(), 2u);
+
+    // Cell rỗng duy nhất không được ghi thành dòng trống làm lệch offset các record sau
+    utility_csv::CSVData single{ { "mssv" }, { { "" }, { "007" }, { "\"8\", 9" }, { "" } } };
+    utility_csv::write_csv(file, single, { .index_column = "mssv" });
+    EXPECT_EQ(utility_csv::read_csv(file).rows, single.rows);
+    auto single_index = utility_csv::CSVIndex::open(file, "mssv");
+    ASSERT_TRUE(single_index.has_value());
+    EXPECT_EQ(single_index->find("").size(), 2u);
+    EXPECT_EQ(single_index->find("007").front(), single.rows[1]);
+    EXPECT_EQ(single_index->find("\"8\", 9").front(), single.rows[2]);
+    EXPECT_THROW(utility_csv::write_csv(file, { { "mssv" }, utility_csv::Rows(1) }), std::runtime_error);
+}
+
+TEST(CSVTest, BloomFilterHasNoFalseNegativesAndTracksStaleness) {
+    auto file = fs::temp_directory_path() / "diemdanh_bloom.csv";
+    utility_csv::CSVData data{ { "mssv", "ho_ten" }, {} };
+    for (int i = 0; i < 5000; ++i)
+        data.rows.push_back({ "SV" + std::to_string(i), "Sinh vien" });
+    utility_csv::write_csv(file, data, { .bloom_column = "mssv", .bloom_fp_rate = 0.01 });
+
+    auto filter = utility_csv::BloomFilter::open(file, "mssv");
+    ASSERT_TRUE(filter.has_value());
+    EXPECT_EQ(filter->size(), 5000u);
+
+    for (const auto& row : data.rows)
+        ASSERT_TRUE(filter->might_contain(row[0]));
+
+    int false_positives = 0;
+    for (int i = 0; i < 10000; ++i)
+        false_positives += filter->might_contain("KHAC" + std::to_string(i));
+    EXPECT_LT(false_positives, 300);
+
+    EXPECT_FALSE(utility_csv::BloomFilter::open(file, "ho_ten").has_value());
+
+    data.rows.push_back({ "SV_MOI", "Sinh vien" });
+    utility_csv::write_csv(file, data);
+    EXPECT_FALSE(utility_csv::BloomFilter::open(file, "mssv").has_value());
+    EXPECT_TRUE(utility_csv::BloomFilter::load(file, "mssv").might_contain("SV_MOI"));
+    EXPECT_TRUE(utility_csv::BloomFilter::open(file, "mssv").has_value());
+
+    // Filter mở từ trước lần ghi lại biết mình đã cũ và dựng lại khi refresh()
+    EXPECT_TRUE(filter->stale());
+    filter->refresh();
+    EXPECT_FALSE(filter->stale());
+    EXPECT_TRUE(filter->might_contain("SV_MOI"));
+
+    // Sửa tham số băm trong header (nằm trong checksum) hoặc ra ngoài khoảng hợp lệ đều bị từ chối
+    const auto bloom = utility_csv::bloom_path(file);
+    auto patch_hashes = [&](std::uint32_t hashes) {
+        std::fstream out(bloom, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(40);
+        out.write(reinterpret_cast<const char*>(&hashes), sizeof(hashes));
+    };
+    const auto hashes = filter->hash_count();
+    patch_hashes(hashes + 1);
+    EXPECT_FALSE(utility_csv::BloomFilter::open(file, "mssv").has_value());
+    patch_hashes(1000);
+    EXPECT_FALSE(utility_csv::BloomFilter::open(file, "mssv").has_value());
+    patch_hashes(hashes);
+    EXPECT_TRUE(utility_csv::BloomFilter::open(file, "mssv").has_value());
+}
+
+TEST(CSVTest, EncodedColumnsRoundTrip) {
+    auto file = writeTemp("encoded.csv",
+        "mssv,lop,trang_thai\n001,CTK47,co mat\n002,CTK47,vang\n003,CTK48,co mat\n004,CTK47,muon\n");
+    auto data = utility_csv::read_csv_encoded<std::uint16_t>(file, { .names = { "lop", "trang_thai" } });
+
+    ASSERT_EQ(data.row_count(), 4u);
+    EXPECT_EQ(data.rows.front().size(), 1u);
+    EXPECT_EQ(data.to_csv_data().rows, utility_csv::read_csv(file).rows);
+
+    const auto* status = data.encoded_column("trang_thai");
+    ASSERT_NE(status, nullptr);
+    EXPECT_EQ(status->dictionary.size(), 3u);
+
+    const auto present = *status->dictionary.find("co mat");
+    EXPECT_EQ(std::count(status->codes.begin(), status->codes.end(), present), 2);
+    EXPECT_EQ(data.encoded_column("mssv"), nullptr);
+    EXPECT_EQ(data.cell(2, 1), "CTK48");
+}
+
+TEST(CSVTest, DictionaryOverflowThrows) {
+    utility_csv::Dictionary<std::uint8_t> dictionary;
+    for (int i = 0; i < 256; ++i)
+        dictionary.encode(std::to_string(i));
+    EXPECT_EQ(dictionary.encode("7"), 7);
+    EXPECT_THROW(dictionary.encode("256"), std::runtime_error);
+}
+
+TEST(CSVTest, ColumnHandlesResolveOnce) {
+    auto file = writeTemp("handles.csv", "mssv,ten,diem\n001,An,8\n002,Binh,x\n");
+    auto data = utility_csv::read_csv(file);
+
+    EXPECT_EQ(data.column_of("diem"), 2u);
+    EXPECT_FALSE(data.find_column("lop").has_value());
+    EXPECT_THROW(data.column_of("lop"), std::runtime_error);
+
+    // Đổi tên cột thì bảng tên cột cũ không còn được dùng
+    auto renamed = data;
+    renamed.set_headers({ "mssv", "ten", "diem_tb" });
+    EXPECT_EQ(renamed.column_of("diem_tb"), 2u);
+    EXPECT_THROW(renamed.column_of("diem"), std::runtime_error);
+
+    auto ten = data.handle("ten");
+    auto diem = data.handle<int>("diem");
+    EXPECT_EQ(ten(data.rows[1]), "Binh");
+    EXPECT_EQ(diem(data.rows[0]), 8);
+    EXPECT_THROW(diem(data.rows[1]), std::runtime_error);
+
+    // CSVData dựng tay cũng có bảng tên cột ngay, header trùng tên bị chặn từ lúc dựng
+    EXPECT_THROW((utility_csv::CSVData{ { "mssv", "mssv" } }), std::runtime_error);
+    utility_csv::CSVData manual{ { "mssv", "ten" }, { { "003", "Chi" } } };
+    EXPECT_EQ(manual.handle<std::string>("ten")(manual.rows[0]), "Chi");
+}
+
+TEST(CSVTest, DuplicateHeaderRejectedAtLoad) {
+    auto file = writeTemp("duplicate.csv", "mssv,ten,mssv\n001,An,002\n");
+    EXPECT_THROW(utility_csv::read_csv(file), std::runtime_error);
+    EXPECT_THROW(utility_csv::read_csv_columnar(file), std::runtime_error);
+    EXPECT_THROW(utility_csv::for_each_row(file, [](const utility_csv::RowView&) {}), std::runtime_error);
+    EXPECT_THROW(utility_csv::read_csv_encoded(file, utility_csv::Projection{ .names = { "ten" } }), std::runtime_error);
+}
+
+TEST(CSVTest, DialectDetectedOnceAndCached) {
+    auto cache_file = fs::temp_directory_path() / "diemdanh_dialect_test.cache";
+    fs::remove(cache_file);
+
+    auto file = writeTemp("dialect.csv", "mssv; ten; lop\n001; An; CTK47\n002;\"Binh; Tran\"; CTK48\n");
+
+    utility_csv::DialectCache cache(cache_file);
+    EXPECT_FALSE(cache.lookup(file).has_value());
+
+    auto dialect = cache.detect(file);
+    EXPECT_EQ(dialect.delimiter, ';');
+    EXPECT_EQ(dialect.header_row, 0u);
+    EXPECT_TRUE(dialect.trim);
+    EXPECT_TRUE(dialect.quoted);
+
+    // Mở lại cache từ đĩa: trúng mà không cần quét file
+    utility_csv::DialectCache reopened(cache_file);
+    ASSERT_TRUE(reopened.lookup(file).has_value());
+    EXPECT_EQ(*reopened.lookup(file), dialect);
+
+    auto data = utility_csv::read_csv(file, reopened);
+    ASSERT_EQ(data.row_count(), 2u);
+    EXPECT_EQ(data.rows[1][1], "Binh; Tran");
+
+    writeTemp("dialect.csv", "mssv,ten\n001,An\n");
+    EXPECT_FALSE(reopened.lookup(file).has_value());
+    auto changed = reopened.detect(file);
+    EXPECT_EQ(changed.delimiter, ',');
+    EXPECT_FALSE(changed.trim);
+    EXPECT_EQ(reopened.size(), 1u);
+}
+
+#ifndef _WIN32
+TEST(CSVTest, DialectCacheDefaultsToUserCacheDir) {
+    const char* saved = std::getenv("XDG_CACHE_HOME");
+    const std::string previous = saved ? saved : "";
+    auto root = fs::temp_directory_path() / "diemdanh_xdg";
+    fs::remove_all(root);
+    ::setenv("XDG_CACHE_HOME", root.c_str(), 1);
+
+    const auto path = utility_csv::DialectCache::default_path();
+    EXPECT_EQ(path, root / "diemdanh" / "dialects.cache");
+
+    utility_csv::DialectCache cache;
+    cache.detect(writeTemp("dialect_default.csv", "mssv,ten\n001,An\n"));
+    EXPECT_TRUE(fs::exists(path));
+    EXPECT_EQ(fs::status(path.parent_path()).permissions() & fs::perms::all, fs::perms::owner_all);
+
+    if (saved)
+        ::setenv("XDG_CACHE_HOME", previous.c_str(), 1);
+    else
+        ::unsetenv("XDG_CACHE_HOME");
+    fs::remove_all(root);
+}
+#endif
+
+TEST(CSVTest, WatcherParsesAppendedTailAndReloadsRewrites) {
+    auto roster = fs::temp_directory_path() / "diemdanh_watch_roster.csv";
+    auto other = fs::temp_directory_path() / "diemdanh_watch_other.csv";
+    utility_csv::write_csv(roster, { { "mssv", "ten" }, { { "001", "An" } } });
+    utility_csv::write_csv(other, { { "mssv" }, { { "900" } } });
+
+    utility_csv::CSVWatcher watcher;
+    watcher.watch(roster);
+    watcher.watch(other);
+    EXPECT_TRUE(watcher.poll().empty());
+
+    {
+        utility_csv::CSVAppender appender(roster, { "mssv", "ten" });
+        appender.append({ "002", "Binh, Tran" });
+        appender.append({ "003", "Chi" });
+    }
+
+    auto changes = watcher.poll(std::chrono::milliseconds(1000));
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].kind, utility_csv::ReloadKind::Appended);
+    EXPECT_EQ(changes[0].rows_added, 2u);
+    EXPECT_EQ(watcher.data(roster).rows, utility_csv::read_csv(roster).rows);
+
+    // Dòng chưa ghi xong thì chưa được nhận
+    { std::ofstream(roster, std::ios::app) << "004,Du"; }
+    watcher.poll(std::chrono::milliseconds(1000));
+    EXPECT_EQ(watcher.data(roster).row_count(), 3u);
+    { std::ofstream(roster, std::ios::app) << "ng\n"; }
+    watcher.poll(std::chrono::milliseconds(1000));
+    ASSERT_EQ(watcher.data(roster).row_count(), 4u);
+    EXPECT_EQ(watcher.data(roster).rows.back()[1], "Dung");
+
+    utility_csv::write_csv(roster, { { "mssv", "ten" }, { { "010", "Em" } } });
+    changes = watcher.poll(std::chrono::milliseconds(1000));
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].kind, utility_csv::ReloadKind::Reloaded);
+    EXPECT_EQ(watcher.data(roster).rows, (utility_csv::Rows{ { "010", "Em" } }));
+    EXPECT_EQ(watcher.data(other).row_count(), 1u);
+
+    // Tham chiếu trả về từ watch() vẫn dùng được sau khi theo dõi thêm file
+    const auto& roster_data = watcher.data(roster);
+    for (int i = 0; i < 20; ++i) {
+        auto extra = fs::temp_directory_path() / ("diemdanh_watch_extra" + std::to_string(i) + ".csv");
+        utility_csv::write_csv(extra, { { "mssv" }, { { std::to_string(i) } } });
+        watcher.watch(extra);
+    }
+    EXPECT_EQ(&roster_data, &watcher.data(roster));
+    EXPECT_EQ(roster_data.rows[0][1], "Em");
+
+    // Sửa giữa phần đã parse mà giữ nguyên độ dài rồi nối thêm: phải đọc lại cả file
+    // (chỗ sửa xa cả đầu lẫn cuối nhưng file vẫn nằm gọn trong hai cửa sổ kiểm tra)
+    std::string body = "mssv,ten\n";
+    for (int i = 0; i < 2000; ++i)
+        body += std::to_string(10000 + i) + ",An\n";
+    { std::ofstream(roster, std::ios::trunc) << body; }
+    watcher.poll(std::chrono::milliseconds(1000));
+    ASSERT_EQ(roster_data.row_count(), 2000u);
+
+    body.replace(body.find("11000,An"), 8, "11000,Yn");
+    { std::ofstream(roster, std::ios::trunc) << body << "99999,Lan\n"; }
+    changes = watcher.poll(std::chrono::milliseconds(1000));
+    ASSERT_FALSE(changes.empty());
+    EXPECT_EQ(changes.back().kind, utility_csv::ReloadKind::Reloaded);
+    EXPECT_EQ(roster_data.rows[1000][1], "Yn");
+    EXPECT_EQ(roster_data.row_count(), 2001u);
+
+    // File hỏng chỉ được báo lỗi, thay đổi của file khác trong cùng lần poll vẫn được áp dụng
+    { std::ofstream(roster, std::ios::app) << "014,Hoa,thua\n"; }
+    { std::ofstream(other, std::ios::app) << "901\n"; }
+    std::vector<utility_csv::FileChange> all;
+    for (int i = 0; i < 10 && all.size() < 2; ++i)
+        for (auto& change : watcher.poll(std::chrono::milliseconds(200)))
+            all.push_back(std::move(change));
+
+    auto failed = std::find_if(all.begin(), all.end(), [](const auto& c) { return c.kind == utility_csv::ReloadKind::Failed; });
+    ASSERT_NE(failed, all.end());
+    EXPECT_FALSE(failed->error.empty());
+    EXPECT_EQ(roster_data.row_count(), 2001u);
+    EXPECT_EQ(watcher.data(other).row_count(), 2u);
+}
+
+TEST(CSVTest, TransformPipelineKeepsOrder) {
+    auto input = writeTemp("transform_in.csv", makeRoster(50000));
+    auto output = fs::temp_directory_path() / "diemdanh_transform_out.csv";
+
+    utility_csv::TransformOptions options;
+    options.threads = 4;
+    options.queue_depth = 4;
+    options.batch_rows = 97;
+
+    auto written = utility_csv::transform_csv(input, output, [](utility_csv::Row& row) {
+        if (row[0].back() == '7')
+            return false;
+        row[1] += " (da xu ly)";
+        return true;
+    }, options);
+
+    auto expected = utility_csv::read_csv(input);
+    std::erase_if(expected.rows, [](const utility_csv::Row& row) { return row[0].back() == '7'; });
+    for (auto& row : expected.rows)
+        row[1] += " (da xu ly)";
+
+    auto actual = utility_csv::read_csv(output);
+    EXPECT_EQ(written, expected.row_count());
+    EXPECT_EQ(actual.headers(), expected.headers());
+    EXPECT_TRUE(actual.rows == expected.rows);
+}
+
+TEST(CSVTest, TransformPipelinePropagatesErrors) {
+    auto input = writeTemp("transform_bad.csv", makeRoster(5000));
+    auto output = fs::temp_directory_path() / "diemdanh_transform_bad_out.csv";
+    fs::remove(output);
+
+    EXPECT_THROW(utility_csv::transform_csv(input, output, [](utility_csv::Row& row) {
+        row.pop_back();
+    }, { .threads = 2, .batch_rows = 64 }), std::runtime_error);
+    EXPECT_FALSE(fs::exists(output));
+    EXPECT_FALSE(hasTempSibling(output));
+}
+
+TEST(CSVTest, ExternalSortMatchesStableSort) {
+    auto input = writeTemp("sort_in.csv", makeRoster(20000));
+    auto output = fs::temp_directory_path() / "diemdanh_sort_out.csv";
+
+    utility_csv::SortOptions options;
+    options.keys = { "trang_thai", "ghi_chu" };
+    options.memory_budget = 1 << 20; // ép ra nhiều run
+    options.threads = 3;
+
+    EXPECT_EQ(utility_csv::sort_csv(input, output, options), 20000u);
+
+    auto expected = utility_csv::read_csv(input);
+    std::stable_sort(expected.rows.begin(), expected.rows.end(), [](const auto& a, const auto& b) {
+        return std::tie(a[3], a[2]) < std::tie(b[3], b[2]);
+    });
+
+    auto actual = utility_csv::read_csv(output);
+    EXPECT_EQ(actual.headers(), expected.headers());
+    EXPECT_TRUE(actual.rows == expected.rows);
+
+    // Vừa bộ nhớ: không có run tạm, kết quả như nhau
+    options.memory_budget = 1u << 30;
+    utility_csv::sort_csv(input, output, options);
+    EXPECT_TRUE(utility_csv::read_csv(output).rows == expected.rows);
+
+    options.keys = { "khong_co" };
+    EXPECT_THROW(utility_csv::sort_csv(input, output, options), std::runtime_error);
+}
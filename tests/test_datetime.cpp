@@ -66,3 +66,22 @@ TEST(DateTimeTest, ComparisonOperators) {
     EXPECT_TRUE(d2 > d1);
     EXPECT_FALSE(d1 == d2);
 }
+
+TEST(DateTimeTest, ParseFormats) {
+    auto full = DateTime::parse("01/05/2025 12:30:45");
+    ASSERT_TRUE(full.has_value());
+    EXPECT_EQ(*full, DateTime(1, 5, 2025, 12, 30, 45));
+
+    auto date = DateTime::parse("31/12/2025");
+    ASSERT_TRUE(date.has_value());
+    EXPECT_EQ(*date, DateTime(31, 12, 2025));
+
+    EXPECT_EQ(DateTime::parse(DateTime(2, 3, 2024, 8, 5, 0).toString()), DateTime(2, 3, 2024, 8, 5, 0));
+}
+
+TEST(DateTimeTest, ParseRejectsInvalid) {
+    EXPECT_FALSE(DateTime::parse("31/02/2025").has_value());
+    EXPECT_FALSE(DateTime::parse("01-05-2025").has_value());
+    EXPECT_FALSE(DateTime::parse("01/05/2025 12").has_value());
+    EXPECT_FALSE(DateTime::parse("").has_value());
+}